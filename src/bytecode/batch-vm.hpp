@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include "bytecode.hpp"
+#include "verifier.hpp"
+
+// Runs one spell over many independent targets ("lanes") at once, e.g. an
+// area-of-effect spell hitting thousands of wizards in the same tick.
+//
+// State is stored as structure-of-arrays: every wizard's health is a column
+// with one entry per lane, and every stack slot is a column too. Each
+// instruction is executed once for all lanes with a plain loop over a column,
+// which the compiler turns into SIMD code at -O2/-O3. Values that are the same
+// in every lane (literals, wizard IDs) are kept as a single scalar instead of
+// being broadcast.
+//
+// Only verified spells are accepted: the verifier guarantees wizard IDs and
+// divisors are constants, so lanes never diverge and no per-lane checks are
+// needed.
+class BatchVM {
+public:
+    // Each lane starts with the same wizards as VM
+    explicit BatchVM(size_t lanes)
+        : lanes_(lanes), wizardCount_(2), healths_(wizardCount_ * lanes) {
+        std::fill_n(healthColumn(0), lanes_, 100);
+        std::fill_n(healthColumn(1), lanes_, 80);
+        slots_.reserve(VM::maxStackSize());
+    }
+
+    void run(const VerifiedSpell& spell) {
+        if (spell.wizardCount() > wizardCount_) {
+            throw std::runtime_error("Spell was verified for more wizards than this VM has!");
+        }
+        stack_.resize(spell.maxStackDepth() * lanes_); // Only allocates for a new deepest spell
+        slots_.clear();
+
+        for (const Bytecode& instruction : spell.code()) {
+            switch (instruction.instruction) {
+                case Instruction::LITERAL:
+                    slots_.push_back({true, instruction.argument});
+                    break;
+                case Instruction::ADD:
+                case Instruction::SUB:
+                case Instruction::MUL:
+                case Instruction::DIV: {
+                    Slot operand2 = slots_.back();
+                    slots_.pop_back();
+                    applyBinary(instruction.instruction, slots_.size() - 1, operand2, slots_.size());
+                    break;
+                }
+                case Instruction::ADD_IMM:
+                case Instruction::SUB_IMM:
+                case Instruction::MUL_IMM:
+                case Instruction::DIV_IMM:
+                    // The immediate is just a uniform second operand
+                    applyBinary(instruction.instruction, slots_.size() - 1, {true, instruction.argument}, 0);
+                    break;
+                case Instruction::SET_HEALTH: {
+                    Slot health = slots_.back();
+                    slots_.pop_back();
+                    int wizardId = slots_.back().value; // Uniform: proven constant by the verifier
+                    slots_.pop_back();
+                    storeHealth(wizardId, health, slots_.size() + 1);
+                    break;
+                }
+                case Instruction::SET_HEALTH_IMM: {
+                    Slot health = slots_.back();
+                    slots_.pop_back();
+                    storeHealth(instruction.argument, health, slots_.size());
+                    break;
+                }
+                case Instruction::GET_HEALTH: {
+                    int wizardId = slots_.back().value;
+                    slots_.pop_back();
+                    loadHealth(wizardId);
+                    break;
+                }
+                case Instruction::GET_HEALTH_IMM:
+                    loadHealth(instruction.argument);
+                    break;
+                case Instruction::PLAY_SOUND:
+                    slots_.pop_back();
+                    break;
+                case Instruction::PLAY_SOUND_IMM:
+                    break;
+            }
+        }
+    }
+
+    size_t lanes() const { return lanes_; }
+
+    int* healthColumn(size_t wizard) { return healths_.data() + wizard * lanes_; }
+    const int* healthColumn(size_t wizard) const { return healths_.data() + wizard * lanes_; }
+
+    // The stack one lane would have after the last spell, as VM::getStack() would return it
+    std::vector<int> getStack(size_t lane) const {
+        std::vector<int> stack;
+        for (size_t slot = 0; slot < slots_.size(); ++slot) {
+            stack.push_back(slots_[slot].uniform ? slots_[slot].value : stack_[slot * lanes_ + lane]);
+        }
+        return stack;
+    }
+
+    std::vector<int> getWizardHealths(size_t lane) const {
+        std::vector<int> healths;
+        for (size_t wizard = 0; wizard < wizardCount_; ++wizard) {
+            healths.push_back(healthColumn(wizard)[lane]);
+        }
+        return healths;
+    }
+
+private:
+    // A stack slot is either one value shared by all lanes, or a column in stack_
+    struct Slot {
+        bool uniform;
+        int value;
+    };
+
+    int* column(size_t slot) { return stack_.data() + slot * lanes_; }
+
+    // slots_[target] = slots_[target] op operand2. `operand2Slot` locates the
+    // column of operand2 when it is not uniform.
+    void applyBinary(Instruction instruction, size_t target, Slot operand2, size_t operand2Slot) {
+        Slot& operand1 = slots_[target];
+        if (operand1.uniform && operand2.uniform) {
+            operand1.value = scalar(instruction, operand1.value, operand2.value);
+            return;
+        }
+        int* out = column(target);
+        const int* in = column(operand2Slot);
+        if (operand1.uniform) {
+            const int a = operand1.value;
+            operand1.uniform = false;
+            switch (instruction) {
+                case Instruction::ADD: for (size_t i = 0; i < lanes_; ++i) out[i] = a + in[i]; break;
+                case Instruction::SUB: for (size_t i = 0; i < lanes_; ++i) out[i] = a - in[i]; break;
+                case Instruction::MUL: for (size_t i = 0; i < lanes_; ++i) out[i] = a * in[i]; break;
+                default: for (size_t i = 0; i < lanes_; ++i) out[i] = a / in[i]; break;
+            }
+        } else if (operand2.uniform) {
+            const int b = operand2.value;
+            switch (instruction) {
+                case Instruction::ADD:
+                case Instruction::ADD_IMM: for (size_t i = 0; i < lanes_; ++i) out[i] += b; break;
+                case Instruction::SUB:
+                case Instruction::SUB_IMM: for (size_t i = 0; i < lanes_; ++i) out[i] -= b; break;
+                case Instruction::MUL:
+                case Instruction::MUL_IMM: for (size_t i = 0; i < lanes_; ++i) out[i] *= b; break;
+                default: for (size_t i = 0; i < lanes_; ++i) out[i] /= b; break;
+            }
+        } else {
+            switch (instruction) {
+                case Instruction::ADD: for (size_t i = 0; i < lanes_; ++i) out[i] += in[i]; break;
+                case Instruction::SUB: for (size_t i = 0; i < lanes_; ++i) out[i] -= in[i]; break;
+                case Instruction::MUL: for (size_t i = 0; i < lanes_; ++i) out[i] *= in[i]; break;
+                default: for (size_t i = 0; i < lanes_; ++i) out[i] /= in[i]; break;
+            }
+        }
+    }
+
+    static int scalar(Instruction instruction, int a, int b) {
+        switch (instruction) {
+            case Instruction::ADD:
+            case Instruction::ADD_IMM: return a + b;
+            case Instruction::SUB:
+            case Instruction::SUB_IMM: return a - b;
+            case Instruction::MUL:
+            case Instruction::MUL_IMM: return a * b;
+            default: return a / b;
+        }
+    }
+
+    void storeHealth(int wizardId, Slot health, size_t healthSlot) {
+        int* out = healthColumn(wizardId);
+        if (health.uniform) {
+            std::fill_n(out, lanes_, health.value);
+        } else {
+            std::copy_n(column(healthSlot), lanes_, out);
+        }
+    }
+
+    void loadHealth(int wizardId) {
+        slots_.push_back({false, 0});
+        std::copy_n(healthColumn(wizardId), lanes_, column(slots_.size() - 1));
+    }
+
+    size_t lanes_;
+    size_t wizardCount_;
+    std::vector<int> healths_; // wizardCount_ columns of lanes_ healths each
+    std::vector<int> stack_;   // One column of lanes_ values per stack slot
+    std::vector<Slot> slots_;  // Which stack slots are uniform
+};
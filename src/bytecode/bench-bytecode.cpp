@@ -0,0 +1,487 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bytecode.hpp"
+#include "threaded-vm.hpp"
+#include "verifier.hpp"
+#include "optimizer.hpp"
+#include "batch-vm.hpp"
+#include "spell-bank.hpp"
+#include "closure-compiler.hpp"
+#include "spell-scheduler.hpp"
+#include "profiler.hpp"
+#include "spell-compiler.hpp"
+
+// Benchmarks for the spell VM engines. Pass an iteration count as the first
+// argument to override the default.
+
+namespace {
+
+struct NamedSpell {
+    std::string name;
+    std::vector<Bytecode> code;
+};
+
+std::vector<NamedSpell> benchmarkSpells() {
+    std::vector<NamedSpell> spells = {
+        {"spell2 (heal 10)", {
+            {Instruction::LITERAL, 0}, {Instruction::LITERAL, 0}, {Instruction::GET_HEALTH, 0},
+            {Instruction::LITERAL, 10}, {Instruction::ADD, 0}, {Instruction::SET_HEALTH, 0}}},
+        {"spell3 (damage 20 + sound)", {
+            {Instruction::LITERAL, 1}, {Instruction::LITERAL, 1}, {Instruction::GET_HEALTH, 0},
+            {Instruction::LITERAL, 20}, {Instruction::SUB, 0}, {Instruction::SET_HEALTH, 0},
+            {Instruction::LITERAL, 123}, {Instruction::PLAY_SOUND, 0}}},
+        {"spell4 ((5 + 3) * 2)", {
+            {Instruction::LITERAL, 5}, {Instruction::LITERAL, 3}, {Instruction::ADD, 0},
+            {Instruction::LITERAL, 2}, {Instruction::MUL, 0}}},
+    };
+
+    // A longer arithmetic chain, where dispatch cost dominates
+    NamedSpell chain{"arithmetic chain (64 ops)", {{Instruction::LITERAL, 1}}};
+    const Instruction operations[] = {Instruction::ADD, Instruction::SUB, Instruction::MUL};
+    const int operands[] = {3, 2, 1};
+    for (int i = 0; i < 31; ++i) {
+        chain.code.push_back({Instruction::LITERAL, operands[i % 3]});
+        chain.code.push_back({operations[i % 3], 0});
+    }
+    chain.code.push_back({Instruction::PLAY_SOUND, 0});
+    spells.push_back(chain);
+    return spells;
+}
+
+template <typename Fn>
+double secondsFor(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+void benchThreadedDispatch(long iterations) {
+    std::cout << "== interpret() vs ThreadedVM::run() ==" << std::endl;
+    for (const NamedSpell& spell : benchmarkSpells()) {
+        VM vm;
+        ThreadedVM threadedVm;
+        ThreadedSpell decoded = ThreadedVM::decode(spell.code);
+
+        double switchSeconds = secondsFor([&] {
+            for (long i = 0; i < iterations; ++i) vm.interpret(spell.code);
+        });
+        double threadedSeconds = secondsFor([&] {
+            for (long i = 0; i < iterations; ++i) threadedVm.run(decoded);
+        });
+
+        bool same = vm.getWizardHealths() == threadedVm.getWizardHealths() &&
+                    vm.getStack() == threadedVm.getStack();
+        double instructions = static_cast<double>(spell.code.size()) * iterations;
+        std::cout << spell.name << ": "
+                  << "switch " << instructions / switchSeconds / 1e6 << " Minstr/s, "
+                  << "threaded " << instructions / threadedSeconds / 1e6 << " Minstr/s, "
+                  << "speedup x" << switchSeconds / threadedSeconds
+                  << (same ? "" : " [RESULTS DIFFER]") << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void benchVerifiedFastPath(long iterations) {
+    std::cout << "== interpret() vs VM::runVerified() ==" << std::endl;
+    for (const NamedSpell& spell : benchmarkSpells()) {
+        VM vm;
+        VM fastVm;
+        VerifiedSpell verified = verifySpell(spell.code, fastVm.getWizardHealths().size());
+
+        double checkedSeconds = secondsFor([&] {
+            for (long i = 0; i < iterations; ++i) vm.interpret(spell.code);
+        });
+        double verifiedSeconds = secondsFor([&] {
+            for (long i = 0; i < iterations; ++i) fastVm.runVerified(verified);
+        });
+
+        bool same = vm.getWizardHealths() == fastVm.getWizardHealths() && vm.getStack() == fastVm.getStack();
+        double instructions = static_cast<double>(spell.code.size()) * iterations;
+        std::cout << spell.name << ": "
+                  << "checked " << instructions / checkedSeconds / 1e6 << " Minstr/s, "
+                  << "verified " << instructions / verifiedSeconds / 1e6 << " Minstr/s, "
+                  << "speedup x" << checkedSeconds / verifiedSeconds
+                  << (same ? "" : " [RESULTS DIFFER]") << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+// The game's own wizard storage, reached through SpellHost callbacks
+struct HostHealths {
+    int healths[2] = {100, 80};
+};
+
+SpellHost hostFor(HostHealths& table) {
+    SpellHost host;
+    host.user = &table;
+    host.getHealth = [](void* user, int wizardId, int& health) {
+        if (wizardId < 0 || wizardId >= 2) return false;
+        health = static_cast<HostHealths*>(user)->healths[wizardId];
+        return true;
+    };
+    host.setHealth = [](void* user, int wizardId, int health) {
+        if (wizardId < 0 || wizardId >= 2) return false;
+        static_cast<HostHealths*>(user)->healths[wizardId] = health;
+        return true;
+    };
+    host.playSound = [](void*, int) {};
+    return host;
+}
+
+void benchHostBindings(long iterations) {
+    std::cout << "== interpret(): own wizard table vs SpellHost callbacks ==" << std::endl;
+    for (const NamedSpell& spell : benchmarkSpells()) {
+        VM vm;
+        HostHealths table;
+        VM hostedVm(hostFor(table));
+
+        double ownSeconds = secondsFor([&] {
+            for (long i = 0; i < iterations; ++i) vm.interpret(spell.code);
+        });
+        double hostSeconds = secondsFor([&] {
+            for (long i = 0; i < iterations; ++i) hostedVm.interpret(spell.code);
+        });
+
+        bool same = vm.getWizardHealths() == std::vector<int>(table.healths, table.healths + 2) &&
+                    vm.getStack() == hostedVm.getStack();
+        double instructions = static_cast<double>(spell.code.size()) * iterations;
+        std::cout << spell.name << ": "
+                  << "own table " << instructions / ownSeconds / 1e6 << " Minstr/s, "
+                  << "host " << instructions / hostSeconds / 1e6 << " Minstr/s"
+                  << (same ? "" : " [RESULTS DIFFER]") << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void benchProfiler(long iterations) {
+    std::cout << "== interpret(): profiler off vs on ==" << std::endl;
+    for (const NamedSpell& spell : benchmarkSpells()) {
+        VM vm;
+        SpellProfiler profiler;
+        VM profiledVm;
+        profiledVm.setProfiler(&profiler);
+
+        double offSeconds = secondsFor([&] {
+            for (long i = 0; i < iterations; ++i) vm.interpret(spell.code);
+        });
+        double onSeconds = secondsFor([&] {
+            for (long i = 0; i < iterations; ++i) profiledVm.interpret(spell.code);
+        });
+
+        bool same = vm.getWizardHealths() == profiledVm.getWizardHealths() && vm.getStack() == profiledVm.getStack() &&
+                    profiler.spells().begin()->second.calls == static_cast<std::uint64_t>(iterations);
+        double instructions = static_cast<double>(spell.code.size()) * iterations;
+        std::cout << spell.name << ": "
+                  << "off " << instructions / offSeconds / 1e6 << " Minstr/s, "
+                  << "on " << instructions / onSeconds / 1e6 << " Minstr/s, "
+                  << "overhead x" << onSeconds / offSeconds
+                  << (same ? "" : " [RESULTS DIFFER]") << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void benchOptimizer(long iterations) {
+    std::cout << "== ThreadedVM: original vs optimizeSpell() ==" << std::endl;
+    for (const NamedSpell& spell : benchmarkSpells()) {
+        OptimizationReport report;
+        ThreadedSpell original = ThreadedVM::decode(spell.code);
+        ThreadedSpell optimized = ThreadedVM::decode(optimizeSpell(verifySpell(spell.code, 2), &report));
+        ThreadedVM originalVm;
+        ThreadedVM optimizedVm;
+
+        double originalSeconds = secondsFor([&] {
+            for (long i = 0; i < iterations; ++i) originalVm.run(original);
+        });
+        double optimizedSeconds = secondsFor([&] {
+            for (long i = 0; i < iterations; ++i) optimizedVm.run(optimized);
+        });
+
+        bool same = originalVm.getWizardHealths() == optimizedVm.getWizardHealths() &&
+                    originalVm.getStack() == optimizedVm.getStack();
+        std::cout << spell.name << ": "
+                  << report.originalInstructions << " -> " << report.optimizedInstructions << " instructions, "
+                  << "spells/s x" << originalSeconds / optimizedSeconds
+                  << (same ? "" : " [RESULTS DIFFER]") << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void benchBatch(long iterations) {
+    std::cout << "== N x VM::runVerified() vs BatchVM::run() ==" << std::endl;
+    std::vector<NamedSpell> spells = benchmarkSpells();
+    spells.resize(2); // spell2 and spell3 touch wizard state
+    spells.push_back({"aoe (health * 3 / 4 - 5)", {
+        {Instruction::LITERAL, 1}, {Instruction::LITERAL, 1}, {Instruction::GET_HEALTH, 0},
+        {Instruction::LITERAL, 3}, {Instruction::MUL, 0}, {Instruction::LITERAL, 4}, {Instruction::DIV, 0},
+        {Instruction::LITERAL, 5}, {Instruction::SUB, 0}, {Instruction::SET_HEALTH, 0}}});
+
+    for (size_t lanes : {size_t(64), size_t(4096), size_t(65536)}) {
+        long ticks = std::max(1L, iterations / static_cast<long>(lanes));
+        for (const NamedSpell& spell : spells) {
+            VerifiedSpell verified = verifySpell(optimizeSpell(verifySpell(spell.code, 2)), 2);
+            std::vector<VM> vms(lanes);
+            BatchVM batch(lanes);
+
+            double scalarSeconds = secondsFor([&] {
+                for (long tick = 0; tick < ticks; ++tick) {
+                    for (VM& vm : vms) vm.runVerified(verified);
+                }
+            });
+            double batchSeconds = secondsFor([&] {
+                for (long tick = 0; tick < ticks; ++tick) batch.run(verified);
+            });
+
+            bool same = true;
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                same = same && vms[lane].getWizardHealths() == batch.getWizardHealths(lane);
+            }
+            double casts = static_cast<double>(lanes) * ticks;
+            std::cout << spell.name << " x" << lanes << " lanes: "
+                      << "scalar " << casts / scalarSeconds / 1e6 << " Mcasts/s, "
+                      << "batch " << casts / batchSeconds / 1e6 << " Mcasts/s, "
+                      << "speedup x" << scalarSeconds / batchSeconds
+                      << (same ? "" : " [RESULTS DIFFER]") << std::endl;
+        }
+    }
+    std::cout << std::endl;
+}
+
+void benchSpellBank(long iterations) {
+    std::cout << "== std::vector<Bytecode> vs mmap'd SpellBank ==" << std::endl;
+    std::vector<NamedSpell> templates = benchmarkSpells();
+    const size_t spellCount = 10000;
+    std::vector<std::vector<Bytecode>> spells;
+    for (size_t i = 0; i < spellCount; ++i) {
+        std::vector<Bytecode> spell = templates[i % templates.size()].code;
+        spell[0].argument = static_cast<int>(i % 2); // Vary the target a little
+        spells.push_back(spell);
+    }
+    const char* path = "bench-spells.bank";
+    writeSpellBank(path, spells);
+
+    // Startup: map the bank, versus decoding it into vectors
+    std::vector<std::vector<Bytecode>> decoded;
+    double decodeSeconds = secondsFor([&] {
+        SpellBank bank(path);
+        decoded.reserve(bank.size());
+        for (size_t i = 0; i < bank.size(); ++i) {
+            CompactSpell spell = bank.spell(i);
+            std::vector<Bytecode> code;
+            for (const std::uint8_t* ip = spell.begin; ip != spell.end;) {
+                code.push_back(decodeInstruction(ip, spell.end));
+            }
+            decoded.push_back(std::move(code));
+        }
+    });
+    std::unique_ptr<SpellBank> mapped;
+    double mapSeconds = secondsFor([&] { mapped.reset(new SpellBank(path)); });
+    const SpellBank& bank = *mapped;
+
+    // Counted as if every vector were exactly sized, which favours the vectors
+    size_t vectorBytes = decoded.size() * sizeof(std::vector<Bytecode>);
+    for (const std::vector<Bytecode>& spell : decoded) {
+        vectorBytes += spell.size() * sizeof(Bytecode);
+    }
+    std::cout << spellCount << " spells: vectors " << vectorBytes << " bytes, bank " << bank.bytes()
+              << " bytes (" << 100.0 * bank.bytes() / vectorBytes << "%)" << std::endl;
+    std::cout << "startup: decode to vectors " << decodeSeconds * 1e3 << " ms, map bank "
+              << mapSeconds * 1e3 << " ms" << std::endl;
+
+    // Execution: interpret every spell in the bank
+    long passes = std::max(1L, iterations / static_cast<long>(spellCount));
+    VM vectorVm;
+    VM bankVm;
+    double vectorSeconds = secondsFor([&] {
+        for (long pass = 0; pass < passes; ++pass) {
+            for (const std::vector<Bytecode>& spell : decoded) vectorVm.interpret(spell);
+        }
+    });
+    double bankSeconds = secondsFor([&] {
+        for (long pass = 0; pass < passes; ++pass) {
+            for (size_t i = 0; i < bank.size(); ++i) bankVm.interpret(bank.spell(i));
+        }
+    });
+    bool same = vectorVm.getWizardHealths() == bankVm.getWizardHealths();
+    double casts = static_cast<double>(spellCount) * passes;
+    std::cout << "interpret: vectors " << casts / vectorSeconds / 1e6 << " Mspells/s, bank "
+              << casts / bankSeconds / 1e6 << " Mspells/s" << (same ? "" : " [RESULTS DIFFER]") << std::endl;
+
+    mapped.reset();
+    std::remove(path);
+    std::cout << std::endl;
+}
+
+template <typename Spell>
+void benchStaticSpell(const std::string& name, const std::vector<Bytecode>& code, long iterations) {
+    VM vm;
+    VM verifiedVm;
+    VM compiledVm;
+    VM staticVm;
+    ThreadedVM threadedVm;
+    VerifiedSpell verified = verifySpell(code, 2);
+    CompiledSpell compiled = compileSpell(verified);
+    ThreadedSpell threaded = ThreadedVM::decode(code);
+
+    double interpretSeconds = secondsFor([&] {
+        for (long i = 0; i < iterations; ++i) vm.interpret(code);
+    });
+    double verifiedSeconds = secondsFor([&] {
+        for (long i = 0; i < iterations; ++i) verifiedVm.runVerified(verified);
+    });
+    double threadedSeconds = secondsFor([&] {
+        for (long i = 0; i < iterations; ++i) threadedVm.run(threaded);
+    });
+    double compiledSeconds = secondsFor([&] {
+        for (long i = 0; i < iterations; ++i) compiledVm.run(compiled);
+    });
+    double staticSeconds = secondsFor([&] {
+        for (long i = 0; i < iterations; ++i) staticVm.run(Spell());
+    });
+
+    bool same = vm.getWizardHealths() == compiledVm.getWizardHealths() && vm.getStack() == compiledVm.getStack() &&
+                vm.getWizardHealths() == staticVm.getWizardHealths() && vm.getStack() == staticVm.getStack();
+    auto rate = [iterations](double seconds) { return iterations / seconds / 1e6; };
+    std::cout << name << " (Mspells/s): interpret " << rate(interpretSeconds)
+              << ", verified " << rate(verifiedSeconds)
+              << ", threaded " << rate(threadedSeconds)
+              << ", closures " << rate(compiledSeconds)
+              << ", build-time " << rate(staticSeconds)
+              << " | closures x" << interpretSeconds / compiledSeconds << " over interpret"
+              << (same ? "" : " [RESULTS DIFFER]") << std::endl;
+}
+
+void benchClosureCompiler(long iterations) {
+    std::cout << "== Closure and build-time compilation ==" << std::endl;
+    using I = Instruction;
+    std::vector<NamedSpell> spells = benchmarkSpells();
+    benchStaticSpell<StaticSpell<Op<I::LITERAL, 0>, Op<I::LITERAL, 0>, Op<I::GET_HEALTH>,
+                                 Op<I::LITERAL, 10>, Op<I::ADD>, Op<I::SET_HEALTH>>>(
+        spells[0].name, spells[0].code, iterations);
+    benchStaticSpell<StaticSpell<Op<I::LITERAL, 1>, Op<I::LITERAL, 1>, Op<I::GET_HEALTH>,
+                                 Op<I::LITERAL, 20>, Op<I::SUB>, Op<I::SET_HEALTH>,
+                                 Op<I::LITERAL, 123>, Op<I::PLAY_SOUND>>>(
+        spells[1].name, spells[1].code, iterations);
+    std::cout << std::endl;
+}
+
+// A varied source text for the i-th spell of a generated bank
+std::string generatedSpellSource(size_t i) {
+    std::string wizard = std::to_string(i % 2);
+    std::string amount = std::to_string(i % 97 + 1);
+    switch (i % 4) {
+        case 0: return "health[" + wizard + "] = health[" + wizard + "] + " + amount + " * 2; sound(" +
+                       std::to_string(i) + ")";
+        case 1: return "# damage over time\nhealth[" + wizard + "] = health[" + wizard + "] - (" + amount +
+                       " + 3) / 2";
+        case 2: return "health[0] = (health[0] + health[1]) / 2; health[1] = health[0] - " + amount +
+                       "; sound(" + std::to_string(i) + ")";
+        default: return "(" + amount + " + " + std::to_string(i) + ") * -3 - health[" + wizard + "]";
+    }
+}
+
+void benchSpellCompiler() {
+    std::cout << "== Spell compiler and SpellCache ==" << std::endl;
+    const char* path = "bench-spells.cache";
+    for (size_t count : {10000, 100000}) {
+        std::vector<std::string> sources;
+        size_t sourceBytes = 0;
+        for (size_t i = 0; i < count; ++i) {
+            sources.push_back(generatedSpellSource(i));
+            sourceBytes += sources.back().size();
+        }
+
+        size_t instructions = 0;
+        double compileSeconds = secondsFor([&] {
+            for (const std::string& source : sources) instructions += compileSpellSource(source).size();
+        });
+
+        SpellCache cache;
+        double missSeconds = secondsFor([&] {
+            for (const std::string& source : sources) cache.compile(source);
+        });
+        double hitSeconds = secondsFor([&] {
+            for (const std::string& source : sources) cache.compile(source);
+        });
+        cache.save(path);
+
+        // Next startup: load the cache file, then ask for every spell again
+        size_t recompiled = 0;
+        double startupSeconds = secondsFor([&] {
+            SpellCache loaded(path);
+            for (const std::string& source : sources) loaded.compile(source);
+            recompiled = loaded.misses();
+        });
+        std::remove(path);
+
+        double n = static_cast<double>(count);
+        std::cout << count << " spells (" << sourceBytes / 1024 << " KiB source, " << instructions
+                  << " instructions): compile " << n / compileSeconds / 1e3 << " kspells/s ("
+                  << sourceBytes / compileSeconds / 1e6 << " MB/s), cache miss " << n / missSeconds / 1e3
+                  << " kspells/s, cache hit " << n / hitSeconds / 1e3 << " kspells/s, startup from cache file "
+                  << startupSeconds * 1e3 << " ms vs " << compileSeconds * 1e3 << " ms compiling"
+                  << (recompiled == 0 ? "" : " [RESULTS DIFFER]") << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void benchScheduler(long iterations) {
+    std::cout << "== SpellScheduler: spells/s by thread count ==" << std::endl;
+    // Heal or damage each of 1024 wizards with a short calculation
+    const int wizards = 1024;
+    std::vector<std::vector<Bytecode>> spells;
+    for (int w = 0; w < wizards; ++w) {
+        spells.push_back({{Instruction::LITERAL, w}, {Instruction::LITERAL, w}, {Instruction::GET_HEALTH, 0},
+                          {Instruction::LITERAL, w % 7 + 1}, {Instruction::LITERAL, 3}, {Instruction::MUL, 0},
+                          {w % 2 ? Instruction::ADD : Instruction::SUB, 0}, {Instruction::SET_HEALTH, 0},
+                          {Instruction::LITERAL, w % 16}, {Instruction::PLAY_SOUND, 0}});
+    }
+    const size_t spellsPerTick = 64 * 1024;
+    long ticks = std::max(1L, iterations / static_cast<long>(spellsPerTick));
+
+    size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> reference;
+    for (size_t threads = 1; threads <= maxThreads; ++threads) {
+        SpellScheduler scheduler(threads);
+        std::vector<int> healths(wizards, 100);
+        double seconds = secondsFor([&] {
+            for (long tick = 0; tick < ticks; ++tick) {
+                for (size_t i = 0; i < spellsPerTick; ++i) scheduler.enqueue(spells[(i * 31 + tick) % wizards]);
+                scheduler.runTick(healths);
+            }
+        });
+        if (threads == 1) {
+            reference = healths;
+        }
+        std::cout << threads << " thread" << (threads == 1 ? "" : "s") << ": "
+                  << static_cast<double>(spellsPerTick) * ticks / seconds / 1e6 << " Mspells/s"
+                  << (healths == reference ? "" : " [RESULTS DIFFER]") << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    long iterations = argc > 1 ? std::atol(argv[1]) : 1000000;
+
+    benchThreadedDispatch(iterations);
+    benchVerifiedFastPath(iterations);
+    benchHostBindings(iterations);
+    benchProfiler(iterations);
+    benchOptimizer(iterations);
+    benchBatch(iterations);
+    benchSpellBank(iterations);
+    benchClosureCompiler(iterations);
+    benchScheduler(iterations);
+    benchSpellCompiler();
+
+    return 0;
+}
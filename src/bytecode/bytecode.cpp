@@ -1,186 +1,49 @@
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
+#include <sstream>
+#include <string>
 #include <vector>
-#include <stdexcept>
-
-// Define a simple instruction set for our spell VM
-enum class Instruction {
-    LITERAL,     // Push a literal integer onto the stack
-    ADD,         // Pop two values, add them, push the result
-    SUB,         // Pop two values, subtract (second - top), push the result
-    MUL,         // Pop two values, multiply them, push the result
-    DIV,         // Pop two values, divide (second / top), push the result
-    SET_HEALTH,  // Pop health amount, pop wizard ID, set wizard health
-    GET_HEALTH,  // Pop wizard ID, push wizard health
-    PLAY_SOUND   // Pop sound ID, simulate playing a sound
-};
-
-// Represents a single bytecode instruction, possibly with an argument
-struct Bytecode {
-    Instruction instruction;
-    int argument; // Optional argument for instructions like LITERAL
-};
-
-// helper function for debugging, gives you the name of instruction
-std::string instructionToString(Instruction instruction) {
-    switch (instruction) {
-        case Instruction::LITERAL: return "LITERAL";
-        case Instruction::ADD: return "ADD";
-        case Instruction::SUB: return "SUB";
-        case Instruction::MUL: return "MUL";
-        case Instruction::DIV: return "DIV";
-        case Instruction::SET_HEALTH: return "SET_HEALTH";
-        case Instruction::GET_HEALTH: return "GET_HEALTH";
-        case Instruction::PLAY_SOUND: return "PLAY_SOUND";
-        default: return "UNKNOWN";
+#include "bytecode.hpp"
+#include "threaded-vm.hpp"
+#include "verifier.hpp"
+#include "optimizer.hpp"
+#include "batch-vm.hpp"
+#include "spell-bank.hpp"
+#include "closure-compiler.hpp"
+#include "spell-scheduler.hpp"
+#include "profiler.hpp"
+#include "spell-compiler.hpp"
+
+// A game-side wizard table with real sound playback, reached through SpellHost
+struct Arena {
+    std::vector<int> healths{100, 80, 90};
+    std::vector<int> soundsPlayed;
+
+    SpellHost host() {
+        SpellHost host;
+        host.user = this;
+        host.getHealth = [](void* user, int wizardId, int& health) {
+            Arena* arena = static_cast<Arena*>(user);
+            if (wizardId < 0 || wizardId >= static_cast<int>(arena->healths.size())) return false;
+            health = arena->healths[wizardId];
+            return true;
+        };
+        host.setHealth = [](void* user, int wizardId, int health) {
+            Arena* arena = static_cast<Arena*>(user);
+            if (wizardId < 0 || wizardId >= static_cast<int>(arena->healths.size())) return false;
+            arena->healths[wizardId] = health;
+            return true;
+        };
+        host.playSound = [](void* user, int soundId) {
+            static_cast<Arena*>(user)->soundsPlayed.push_back(soundId);
+        };
+        return host;
     }
-}
-
-// Our simple stack-based Virtual Machine for spells
-class VM {
-public:
-    VM() : wizardHealths_{100, 80} {} // Initialize health for two wizards
-
-    void interpret(const std::vector<Bytecode>& bytecode) {
-        stack_.clear(); // Clear the stack before interpreting a new spell
-
-        for (size_t i = 0; i < bytecode.size(); ++i) {
-            const Bytecode& instruction = bytecode[i];
-
-#ifdef DEBUG
-            // Debug: Print the current instruction and stack state
-            std::cout << "Executing Instruction: " << instructionToString(instruction.instruction)
-                      << " (Argument: " << instruction.argument << ")" << std::endl;
-            std::cout << "Stack before execution: ";
-            printStack();
-#endif
-
-            switch (instruction.instruction) {
-                case Instruction::LITERAL:
-                    push(instruction.argument); // Push the literal value onto the stack
-                    break;
-                case Instruction::ADD: {
-                    int operand2 = pop();
-                    int operand1 = pop();
-                    push(operand1 + operand2); // Pop two, add, push
-                    break;
-                }
-                case Instruction::SUB: {
-                    int operand2 = pop();
-                    int operand1 = pop();
-                    push(operand1 - operand2);
-                    break;
-                }
-                case Instruction::MUL: {
-                    int operand2 = pop();
-                    int operand1 = pop();
-                    push(operand1 * operand2);
-                    break;
-                }
-                case Instruction::DIV: {
-                    int operand2 = pop();
-                    int operand1 = pop();
-                    if (operand2 == 0) {
-                        throw std::runtime_error("Division by zero!");
-                    }
-                    push(operand1 / operand2);
-                    break;
-                }
-                case Instruction::SET_HEALTH: {
-                    int health = pop();
-                    int wizardId = pop();
-                    if (wizardId >= 0 && wizardId < wizardHealths_.size()) {
-                        wizardHealths_[wizardId] = health; // Set the health of the specified wizard
-#ifdef DEBUG
-                        std::cout << "Wizard " << wizardId << " health set to " << health << std::endl;
-#endif
-                    } else {
-                        std::cerr << "Error: Invalid wizard ID: " << wizardId << std::endl;
-                    }
-                    break;
-                }
-                case Instruction::GET_HEALTH: {
-                    int wizardId = pop();
-                    if (wizardId >= 0 && wizardId < wizardHealths_.size()) {
-                        push(wizardHealths_[wizardId]); // Push the health of the specified wizard onto the stack
-#ifdef DEBUG
-                        std::cout << "Pushed Wizard " << wizardId << " health (" << wizardHealths_[wizardId] << ") onto the stack." << std::endl;
-#endif
-                    } else {
-                        std::cerr << "Error: Invalid wizard ID: " << wizardId << std::endl;
-                    }
-                    break;
-                }
-                case Instruction::PLAY_SOUND: {
-                    int soundId = pop();
-#ifdef DEBUG
-                    std::cout << "Playing sound with ID: " << soundId << std::endl; // Simulate playing a sound
-#endif
-                    break;
-                }
-                default:
-                    std::cerr << "Error: Unknown instruction." << std::endl;
-                    return;
-            }
-
-#ifdef DEBUG
-            // Debug: Print the stack state after execution
-            std::cout << "Stack after execution: ";
-            printStack();
-            std::cout << std::endl;
-#endif
-        }
-
-        std::cout << "Spell execution finished." << std::endl;
-    }
-
-    // Get the current health of all wizards
-    void printWizardHealth() const {
-        for (size_t i = 0; i < wizardHealths_.size(); ++i) {
-            std::cout << "Wizard " << i << " Health: " << wizardHealths_[i] << std::endl;
-        }
-    }
-
-    std::vector<int> &getStack() {
-        return stack_;
-    }
-
-    void printStack() const {
-        if (stack_.empty()) {
-            std::cout << "[Empty]" << std::endl;
-        } else {
-            for (int value : stack_) {
-                std::cout << value << " ";
-            }
-            std::cout << std::endl;
-        }
-    }
-
-private:
-    void push(int value) {
-        if (stack_.size() >= maxStackSize_) {
-            throw std::runtime_error("Stack overflow!"); // Prevent stack overflow
-        }
-        stack_.push_back(value); // Push a value onto the stack
-    }
-
-    int pop() {
-        if (stack_.empty()) {
-            throw std::runtime_error("Stack underflow!"); // Ensure the stack is not empty before popping
-        }
-        int value = stack_.back();
-        stack_.pop_back();
-        return value; // Pop a value from the stack
-    }
-
-    std::vector<int> stack_; // The operand stack for our VM
-    std::vector<int> wizardHealths_; // Simulate game state (wizard health)
-    static const size_t maxStackSize_ = 128; // Limit the stack size
 };
 
-
-
 int main() {
-    VM vm;
+    VM vm(consoleTraceSink()); // Print "Spell execution finished." and errors, as the VM always used to
 
     std::cout << "Initial Wizard Health:" << std::endl;
     vm.printWizardHealth();
@@ -242,6 +105,203 @@ int main() {
     }
     std::cout << std::endl;
 
+    // Run the same spells through the threaded engine and compare the results
+    std::cout << "Replaying all spells on the threaded VM" << std::endl;
+    ThreadedVM threadedVm;
+    for (const std::vector<Bytecode>* spell : {&spell1, &spell2, &spell3, &spell4}) {
+        threadedVm.run(ThreadedVM::decode(*spell));
+    }
+    threadedVm.printWizardHealth();
+    bool sameResults = threadedVm.getWizardHealths() == vm.getWizardHealths() &&
+                       threadedVm.getStack() == vm.getStack();
+    std::cout << "Threaded VM matches interpret: " << (sameResults ? "yes" : "no") << std::endl;
+    std::cout << std::endl;
+
+    // Verify every spell once at load time, then run them without runtime checks
+    std::cout << "Verifying spells and running them on the unchecked fast path" << std::endl;
+    VM fastVm;
+    for (const std::vector<Bytecode>* spell : {&spell1, &spell2, &spell3, &spell4}) {
+        VerifiedSpell verified = verifySpell(*spell, fastVm.getWizardHealths().size());
+        std::cout << "Verified spell: max stack depth " << verified.maxStackDepth() << std::endl;
+        fastVm.runVerified(verified);
+    }
+    sameResults = fastVm.getWizardHealths() == vm.getWizardHealths() && fastVm.getStack() == vm.getStack();
+    std::cout << "Fast path matches interpret: " << (sameResults ? "yes" : "no") << std::endl;
+
+    // A spell that reads a wizard that does not exist is rejected up front
+    std::vector<Bytecode> badSpell = {
+        {Instruction::LITERAL, 5},      // Push wizard ID 5 (there are only two wizards)
+        {Instruction::GET_HEALTH, 0}
+    };
+    try {
+        verifySpell(badSpell, fastVm.getWizardHealths().size());
+    } catch (const VerificationError& error) {
+        std::cout << error.what() << std::endl;
+    }
+    std::cout << std::endl;
+
+    // Fold constants and fuse superinstructions in the verified spells, then
+    // check the optimized spells agree
+    std::cout << "Optimizing spells" << std::endl;
+    VM optimizedVm;
+    for (const std::vector<Bytecode>* spell : {&spell1, &spell2, &spell3, &spell4}) {
+        OptimizationReport report;
+        std::vector<Bytecode> optimized =
+            optimizeSpell(verifySpell(*spell, optimizedVm.getWizardHealths().size()), &report);
+        std::cout << report.originalInstructions << " -> " << report.optimizedInstructions
+                  << " instructions (removed " << report.removed() << "):";
+        for (const Bytecode& instruction : optimized) {
+            std::cout << " " << instructionToString(instruction.instruction) << " " << instruction.argument << ";";
+        }
+        std::cout << std::endl;
+        optimizedVm.interpret(optimized);
+    }
+    sameResults = optimizedVm.getWizardHealths() == vm.getWizardHealths() && optimizedVm.getStack() == vm.getStack();
+    std::cout << "Optimized spells match interpret: " << (sameResults ? "yes" : "no") << std::endl;
+    std::cout << std::endl;
+
+    // Cast spell 3 on four opponents at once, each starting with different health
+    std::cout << "Casting Spell 3 as an area-of-effect spell on 4 targets" << std::endl;
+    BatchVM batch(4);
+    for (size_t lane = 0; lane < batch.lanes(); ++lane) {
+        batch.healthColumn(1)[lane] = 80 - 20 * static_cast<int>(lane);
+    }
+    batch.run(verifySpell(spell3, 2));
+    for (size_t lane = 0; lane < batch.lanes(); ++lane) {
+        std::cout << "Target " << lane << " Wizard 1 Health: " << batch.getWizardHealths(lane)[1] << std::endl;
+    }
+    std::cout << std::endl;
+
+    // Save the spells to a compact spell bank, map it back in and run it in place
+    std::cout << "Saving spells to a spell bank and running them from the mapped file" << std::endl;
+    const char* bankPath = "spells.bank";
+    writeSpellBank(bankPath, {spell1, spell2, spell3, spell4});
+    {
+        SpellBank bank(bankPath);
+        size_t bytecodeBytes = (spell1.size() + spell2.size() + spell3.size() + spell4.size()) * sizeof(Bytecode);
+        std::cout << bank.size() << " spells, " << bank.bytes() << " bytes on disk (instructions: "
+                  << bytecodeBytes << " bytes as Bytecode)" << std::endl;
+        VM bankVm;
+        for (size_t i = 0; i < bank.size(); ++i) {
+            bankVm.interpret(bank.spell(i));
+        }
+        sameResults = bankVm.getWizardHealths() == vm.getWizardHealths() && bankVm.getStack() == vm.getStack();
+        std::cout << "Spell bank matches interpret: " << (sameResults ? "yes" : "no") << std::endl;
+    }
+    std::remove(bankPath);
+    std::cout << std::endl;
+
+    // Compile the spells to closures, and spell 2 to straight-line code at build time
+    std::cout << "Running compiled spells" << std::endl;
+    VM compiledVm;
+    for (const std::vector<Bytecode>* spell : {&spell1, &spell2, &spell3, &spell4}) {
+        CompiledSpell compiled = compileSpell(verifySpell(*spell, 2));
+        std::cout << "Compiled spell: " << spell->size() << " instructions -> "
+                  << compiled.statementCount() << " closure statements" << std::endl;
+        compiledVm.run(compiled);
+    }
+    sameResults = compiledVm.getWizardHealths() == vm.getWizardHealths() && compiledVm.getStack() == vm.getStack();
+    std::cout << "Closures match interpret: " << (sameResults ? "yes" : "no") << std::endl;
+
+    using Spell2 = StaticSpell<Op<Instruction::LITERAL, 0>, Op<Instruction::LITERAL, 0>, Op<Instruction::GET_HEALTH>,
+                               Op<Instruction::LITERAL, 10>, Op<Instruction::ADD>, Op<Instruction::SET_HEALTH>>;
+    VM staticVm;
+    staticVm.run(Spell2());
+    std::cout << "Build-time Spell 2: Wizard 0 Health: " << staticVm.getWizardHealths()[0] << std::endl;
+    std::cout << std::endl;
+
+    // Embed the VM in a game that owns the wizards and plays the sounds itself
+    std::cout << "Casting Spell 3 through a host-bound VM" << std::endl;
+    Arena arena;
+    VM hostedVm(arena.host());
+    hostedVm.interpret(spell3);
+    std::cout << "Arena Wizard 1 Health: " << arena.healths[1] << ", sounds played: " << arena.soundsPlayed.size()
+              << " (ID " << arena.soundsPlayed.back() << ")" << std::endl;
+    std::cout << std::endl;
+
+    // Cast spells 2 and 3 in the same tick on two worker threads. Both read the
+    // health table as it was at the start of the tick.
+    std::cout << "Running Spells 2 and 3 in one tick on 2 threads" << std::endl;
+    SpellScheduler scheduler(2);
+    std::vector<int> tickHealths = {100, 80};
+    scheduler.enqueue(spell2);
+    scheduler.enqueue(spell3);
+    TickReport tick = scheduler.runTick(tickHealths);
+    std::cout << tick.spellsRun << " spells, " << tick.healthWrites << " health writes, "
+              << scheduler.soundsPlayed().size() << " sound played" << std::endl;
+    for (size_t i = 0; i < tickHealths.size(); ++i) {
+        std::cout << "Wizard " << i << " Health: " << tickHealths[i] << std::endl;
+    }
+    std::cout << std::endl;
+
+    // Profile a mix of spells, then switch profiling off again
+    std::cout << "Profiling Spells 1-4, cast 100 times each" << std::endl;
+    SpellProfiler profiler;
+    profiler.nameSpell(spell1, "Spell 1");
+    profiler.nameSpell(spell2, "Spell 2");
+    profiler.nameSpell(spell3, "Spell 3");
+    profiler.nameSpell(spell4, "Spell 4");
+    VM profiledVm;
+    profiledVm.setProfiler(&profiler);
+    for (int cast = 0; cast < 100; ++cast) {
+        for (const std::vector<Bytecode>* spell : {&spell1, &spell2, &spell3, &spell4}) {
+            profiledVm.interpret(*spell);
+        }
+    }
+    profiledVm.setProfiler(nullptr);
+    for (size_t i = 0; i < SpellProfiler::opcodeCount; ++i) {
+        Instruction instruction = static_cast<Instruction>(i);
+        if (profiler.opcode(instruction).count) {
+            std::cout << instructionToString(instruction) << ": " << profiler.opcode(instruction).count << std::endl;
+        }
+    }
+    std::cout << "LITERAL -> LITERAL pairs: " << profiler.pairCount(Instruction::LITERAL, Instruction::LITERAL)
+              << std::endl;
+    const char* spellNames[] = {"Spell 1", "Spell 2", "Spell 3", "Spell 4"};
+    const std::vector<Bytecode>* profiledSpells[] = {&spell1, &spell2, &spell3, &spell4};
+    for (size_t i = 0; i < 4; ++i) {
+        const SpellProfiler::SpellStats& stats = profiler.spells().at(SpellProfiler::hashSpell(*profiledSpells[i]));
+        std::cout << spellNames[i] << ": " << stats.calls << " calls, " << stats.instructions << " instructions"
+                  << std::endl;
+    }
+    // A real game would write the report to a file and compare spell mixes offline
+    std::ostringstream report;
+    profiler.writeJson(report);
+    std::string json = report.str();
+    std::cout << "Full report: " << std::count(json.begin(), json.end(), '\n') << " lines of JSON" << std::endl;
+    std::cout << std::endl;
+
+    // Write the spells as source text and compile them through a cache
+    std::cout << "Compiling spells from source" << std::endl;
+    std::vector<std::string> sources = {
+        "health[0] = 50",
+        "health[0] = health[0] + 10",
+        "health[1] = health[1] - 20; sound(123)",
+        "(5 + 3) * 2"
+    };
+    std::vector<const std::vector<Bytecode>*> handWritten = {&spell1, &spell2, &spell3, &spell4};
+    SpellCache cache;
+    bool sameCode = true;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const std::vector<Bytecode>& compiled = cache.compile(sources[i]);
+        sameCode = sameCode && compiled.size() == handWritten[i]->size();
+        for (size_t j = 0; sameCode && j < compiled.size(); ++j) {
+            sameCode = compiled[j].instruction == (*handWritten[i])[j].instruction &&
+                       compiled[j].argument == (*handWritten[i])[j].argument;
+        }
+    }
+    std::cout << "Compiled source matches hand-written spells: " << (sameCode ? "yes" : "no") << std::endl;
+    for (const std::string& source : sources) {
+        cache.compile(source); // Unchanged source is never compiled twice
+    }
+    std::cout << "Spell cache: " << cache.misses() << " compiled, " << cache.hits() << " reused" << std::endl;
+    try {
+        compileSpellSource("health[0 = 5");
+    } catch (const SpellSyntaxError& error) {
+        std::cout << error.what() << std::endl;
+    }
+    std::cout << std::endl;
+
     return 0;
 }
 
@@ -254,20 +314,49 @@ int main() {
 2.  **Bytecode (`struct Bytecode`)**: A `Bytecode` structure holds an `Instruction` and an optional integer `argument`. This allows us to represent instructions that require immediate data, like pushing a specific number onto the stack (`LITERAL`).
 
 3.  **Virtual Machine (`class VM`)**:
+    *   The game is reached through a `SpellHost`: a table of native callbacks for getting and setting health and playing sounds, bound once when the VM is constructed. A default-constructed VM binds the table to its own `wizardHealths_`.
+    *   `interpret()` does no I/O and, since the stack is reserved up front, no allocation. Messages such as "Spell execution finished." go to an optional `SpellTraceSink`; `consoleTraceSink()` prints them the way the VM always did.
     *   It maintains a `stack_` (a `std::vector` of integers) which is central to the operation of a stack-based VM. Instructions will push operands onto this stack and pop results off of it.
-    *   `wizardHealths_` simulates a small part of the game state, storing the health of two wizards.
+    *   `wizardHealths_` simulates a small part of the game state, storing the health of two wizards, for VMs without a host. The fast paths below index it directly, so they require such a VM.
     *   `push(int value)` adds a value to the top of the stack, with a check for stack overflow.
     *   `pop()` removes and returns the top value from the stack, with a check for stack underflow.
-    *   `interpret(const std::vector<Bytecode>& bytecode)` is the core of the VM. It iterates through the provided bytecode instructions and executes them one by one using a `switch` statement. Each case in the `switch` corresponds to an instruction, popping operands from the stack, performing the operation, and pushing the result back onto the stack (if applicable). For `SET_HEALTH` and `GET_HEALTH`, it interacts with the `wizardHealths_` array. `PLAY_SOUND` simulates playing a sound based on an ID.
+    *   `interpret(const std::vector<Bytecode>& bytecode)` is the core of the VM. It iterates through the provided bytecode instructions and executes them one by one using a `switch` statement. Each case in the `switch` corresponds to an instruction, popping operands from the stack, performing the operation, and pushing the result back onto the stack (if applicable). For `SET_HEALTH`, `GET_HEALTH` and `PLAY_SOUND`, it calls the host.
     *   `printWizardHealth()` is a utility function to display the current health of the wizards.
 
-4.  **`main()` Function**:
-    *   An instance of the `VM` is created.
+4.  **Threaded VM (`class ThreadedVM`, `threaded-vm.hpp`)**: A second engine for hot spells. `decode()` turns a spell into a `ThreadedSpell` once, binding every instruction to the address of its handler and proving the stack can never overflow or underflow. `run()` then jumps from handler to handler with computed goto over a fixed-size `std::array` stack, without any per-instruction capacity checks. Like the other fast paths it works on its own wizard table, and reports invalid wizard IDs to an optional `SpellTraceSink` instead of printing them. `bench_bytecode` compares its instructions/sec with `interpret()`.
+
+5.  **Verifier (`verifySpell()`, `verifier.hpp`)**: Runs once when a spell is loaded. Because bytecode has no jumps, a single pass over the instructions sees everything the spell can do. It tracks the stack depth and the constant value of each slot, and rejects spells that would underflow or overflow, use a wizard ID that is not a valid constant, or divide by something that is not a non-zero constant. Dividing by -1 is also rejected unless the dividend is a constant other than `INT_MIN`, because `INT_MIN / -1` overflows. The resulting `VerifiedSpell` can be run with `VM::runVerified()`, which performs no per-instruction validation at all.
+
+6.  **Optimizer (`optimizeSpell()`, `optimizer.hpp`)**: A peephole pass that folds arithmetic on constants (spell 4 becomes a single `LITERAL 16`) and fuses a `LITERAL` with the instruction that consumes it into a superinstruction such as `GET_HEALTH_IMM` or `ADD_IMM`. Every engine understands the superinstructions, and an `OptimizationReport` records how many instructions were removed. `interpret()` skips a `GET_HEALTH` of a wizard that does not exist without pushing anything, so unverified bytecode is optimized conservatively; passing a `VerifiedSpell` lets the optimizer also fuse a wizard ID pushed at the start of a spell into its final `SET_HEALTH_IMM`.
+
+7.  **Batch VM (`class BatchVM`, `batch-vm.hpp`)**: Runs one verified spell across many targets ("lanes") at once. Wizard healths and stack slots are stored as columns with one entry per lane (structure-of-arrays), so each instruction becomes a single tight loop over a column that the compiler can vectorize. Values shared by every lane, such as literals and wizard IDs, stay scalar.
+
+8.  **Spell bank (`spell-bank.hpp`)**: A compact binary encoding where every instruction is a one-byte opcode, followed by a zigzag varint only when the instruction actually uses its argument. `writeSpellBank()` stores many encoded spells in one file with a small directory, and `SpellBank` maps that file read-only with `mmap`. `VM::interpret()` accepts a `CompactSpell` view and decodes instructions in place, so loading thousands of spells copies nothing.
+
+9.  **Closure compiler (`closure-compiler.hpp`)**: `compileSpell()` rebuilds the expression trees hidden in the stack code and turns each node into a pre-bound function pointer, so spell 2 becomes `setHealth[0](addImm[10](getHealth[0]))` and runs as three direct calls with no dispatch and no operand stack. Values read from health are spilled to temporaries before a `SET_HEALTH` so the order of reads and writes is exactly that of `interpret()`. For spells known at build time, `StaticSpell<Op<...>...>` goes one step further and lets the C++ compiler expand the spell into straight-line code.
+
+10. **Spell scheduler (`class SpellScheduler`, `spell-scheduler.hpp`)**: Runs a tick's worth of queued spells on a pool of threads, each with its own `VM`. The VMs are bound to a `SpellHost` that reads the health table as it was at the start of the tick and writes `SET_HEALTH` and `PLAY_SOUND` effects to a log instead of the table. Spells are handed out in chunks with one log each, and at the end of the tick the logs are applied in queue order, so the result is the same on any number of threads. `bench_bytecode` reports spells/sec from one thread up to the number of cores.
+
+11. **Profiler (`class SpellProfiler`, `profiler.hpp`)**: Attached to a VM with `setProfiler()` and detached again with `setProfiler(nullptr)`, at any time. While attached, `interpret()` reads the CPU cycle counter around every instruction and records counts and cycles per instruction, per pair of consecutive instructions and per spell (identified by a hash of its code). `writeJson()` dumps everything as JSON, so real spell mixes can show which superinstructions are worth adding. Without a profiler the only cost is one pointer check per spell.
+
+12. **Spell compiler (`compileSpellSource()`, `spell-compiler.hpp`)**: A recursive descent compiler for a small expression language: `health[0] = health[0] + 10; sound(123)`. It emits the same bytecode one would write by hand, and reports mistakes as a `SpellSyntaxError` with line and column. `SpellCache` keys compiled spells by their source, found through a hash of it, so unchanged spells are compiled only once. It can save itself to a file that is loaded at the next startup instead of compiling again. The file is written to a temporary name and renamed into place, and a cache file that is truncated or corrupt is discarded and its spells recompiled.
+
+13. **`main()` Function**:
+    *   An instance of the `VM` is created with the console trace sink.
     *   Initial wizard health is printed.
     *   Several example spells are defined as `std::vector<Bytecode>`.
     *   Each spell is interpreted by calling `vm.interpret()`.
     *   After each spell, the wizard health is printed to show the effects.
     *   An example of a pure calculation using the stack is also demonstrated.
+    *   Finally, all spells are replayed on a `ThreadedVM` and on the verified fast path to check that all engines agree, and a spell with a bad wizard ID is rejected by the verifier.
+    *   The spells are then optimized, printed, and interpreted once more to show the results are unchanged.
+    *   Spell 3 is cast on four targets at once with a `BatchVM`.
+    *   The spells are saved to a spell bank, mapped back in and run straight from the file.
+    *   The spells are compiled to closures, and spell 2 is also written as a build-time `StaticSpell`.
+    *   Spell 3 is cast once more on a VM bound to an `Arena` host, which keeps its own wizards and records the sounds played.
+    *   Spells 2 and 3 are run in a single tick on a two-thread `SpellScheduler`.
+    *   The four spells are cast 100 times each with a `SpellProfiler` attached, and its numbers for each spell are printed.
+    *   The four spells are written as source text, compiled through a `SpellCache` and compared with the hand-written bytecode.
 
 **Expected Output:**
 
@@ -300,5 +389,71 @@ Executing Spell 4: Calculation (5 + 3) * 2
 Spell execution finished.
 Calculation result on stack: 16
 
-This simple example demonstrates the fundamental concepts of a stack-based bytecode VM for executing spells. More complex VMs would have a richer instruction set, support different data types, and potentially include control flow instructions. You would also need a front-end (like a simple parser) to translate a higher-level spell description into this low-level bytecode.
+Replaying all spells on the threaded VM
+Wizard 0 Health: 60
+Wizard 1 Health: 60
+Threaded VM matches interpret: yes
+
+Verifying spells and running them on the unchecked fast path
+Verified spell: max stack depth 2
+Verified spell: max stack depth 3
+Verified spell: max stack depth 3
+Verified spell: max stack depth 2
+Fast path matches interpret: yes
+Spell rejected at instruction 1 (GET_HEALTH): invalid wizard ID 5
+
+Optimizing spells
+3 -> 2 instructions (removed 1): LITERAL 50; SET_HEALTH_IMM 0;
+6 -> 3 instructions (removed 3): GET_HEALTH_IMM 0; ADD_IMM 10; SET_HEALTH_IMM 0;
+8 -> 4 instructions (removed 4): GET_HEALTH_IMM 1; SUB_IMM 20; SET_HEALTH_IMM 1; PLAY_SOUND_IMM 123;
+5 -> 1 instructions (removed 4): LITERAL 16;
+Optimized spells match interpret: yes
+
+Casting Spell 3 as an area-of-effect spell on 4 targets
+Target 0 Wizard 1 Health: 60
+Target 1 Wizard 1 Health: 40
+Target 2 Wizard 1 Health: 20
+Target 3 Wizard 1 Health: 0
+
+Saving spells to a spell bank and running them from the mapped file
+4 spells, 79 bytes on disk (instructions: 176 bytes as Bytecode)
+Spell bank matches interpret: yes
+
+Running compiled spells
+Compiled spell: 3 instructions -> 1 closure statements
+Compiled spell: 6 instructions -> 1 closure statements
+Compiled spell: 8 instructions -> 1 closure statements
+Compiled spell: 5 instructions -> 1 closure statements
+Closures match interpret: yes
+Build-time Spell 2: Wizard 0 Health: 110
+
+Casting Spell 3 through a host-bound VM
+Arena Wizard 1 Health: 60, sounds played: 1 (ID 123)
+
+Running Spells 2 and 3 in one tick on 2 threads
+2 spells, 2 health writes, 1 sound played
+Wizard 0 Health: 110
+Wizard 1 Health: 60
+
+Profiling Spells 1-4, cast 100 times each
+LITERAL: 1200
+ADD: 200
+SUB: 100
+MUL: 100
+SET_HEALTH: 300
+GET_HEALTH: 200
+PLAY_SOUND: 100
+LITERAL -> LITERAL pairs: 400
+Spell 1: 100 calls, 300 instructions
+Spell 2: 100 calls, 600 instructions
+Spell 3: 100 calls, 800 instructions
+Spell 4: 100 calls, 500 instructions
+Full report: 32 lines of JSON
+
+Compiling spells from source
+Compiled source matches hand-written spells: yes
+Spell cache: 4 compiled, 4 reused
+Spell syntax error at 1:10: expected ']'
+
+This simple example demonstrates the fundamental concepts of a stack-based bytecode VM for executing spells. More complex VMs would have a richer instruction set, support different data types, and potentially include control flow instructions. `spell-compiler.hpp` provides a simple front-end that translates a higher-level spell description into this low-level bytecode.
 */
\ No newline at end of file
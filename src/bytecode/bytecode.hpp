@@ -0,0 +1,477 @@
+#pragma once
+
+#include <climits>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+// Define a simple instruction set for our spell VM
+enum class Instruction {
+    LITERAL,     // Push a literal integer onto the stack
+    ADD,         // Pop two values, add them, push the result
+    SUB,         // Pop two values, subtract (second - top), push the result
+    MUL,         // Pop two values, multiply them, push the result
+    DIV,         // Pop two values, divide (second / top), push the result
+    SET_HEALTH,  // Pop health amount, pop wizard ID, set wizard health
+    GET_HEALTH,  // Pop wizard ID, push wizard health
+    PLAY_SOUND,  // Pop sound ID, simulate playing a sound
+
+    // Superinstructions produced by optimizeSpell() (optimizer.hpp). Each one
+    // replaces a `LITERAL argument` followed by the plain instruction.
+    GET_HEALTH_IMM, // Push health of wizard `argument`
+    SET_HEALTH_IMM, // Pop health amount, set health of wizard `argument`
+    ADD_IMM,        // Pop a value, push value + `argument`
+    SUB_IMM,        // Pop a value, push value - `argument`
+    MUL_IMM,        // Pop a value, push value * `argument`
+    DIV_IMM,        // Pop a value, push value / `argument`
+    PLAY_SOUND_IMM  // Simulate playing sound `argument`
+};
+
+// Represents a single bytecode instruction, possibly with an argument
+struct Bytecode {
+    Instruction instruction;
+    int argument; // Optional argument for instructions like LITERAL
+};
+
+// helper function for debugging, gives you the name of instruction
+inline std::string instructionToString(Instruction instruction) {
+    switch (instruction) {
+        case Instruction::LITERAL: return "LITERAL";
+        case Instruction::ADD: return "ADD";
+        case Instruction::SUB: return "SUB";
+        case Instruction::MUL: return "MUL";
+        case Instruction::DIV: return "DIV";
+        case Instruction::SET_HEALTH: return "SET_HEALTH";
+        case Instruction::GET_HEALTH: return "GET_HEALTH";
+        case Instruction::PLAY_SOUND: return "PLAY_SOUND";
+        case Instruction::GET_HEALTH_IMM: return "GET_HEALTH_IMM";
+        case Instruction::SET_HEALTH_IMM: return "SET_HEALTH_IMM";
+        case Instruction::ADD_IMM: return "ADD_IMM";
+        case Instruction::SUB_IMM: return "SUB_IMM";
+        case Instruction::MUL_IMM: return "MUL_IMM";
+        case Instruction::DIV_IMM: return "DIV_IMM";
+        case Instruction::PLAY_SOUND_IMM: return "PLAY_SOUND_IMM";
+        default: return "UNKNOWN";
+    }
+}
+
+// Number of values an instruction pops from the stack
+constexpr size_t stackPops(Instruction instruction) {
+    switch (instruction) {
+        case Instruction::LITERAL:
+        case Instruction::GET_HEALTH_IMM:
+        case Instruction::PLAY_SOUND_IMM: return 0;
+        case Instruction::GET_HEALTH:
+        case Instruction::PLAY_SOUND:
+        case Instruction::SET_HEALTH_IMM:
+        case Instruction::ADD_IMM:
+        case Instruction::SUB_IMM:
+        case Instruction::MUL_IMM:
+        case Instruction::DIV_IMM: return 1;
+        default: return 2;
+    }
+}
+
+// Number of values an instruction pushes onto the stack
+constexpr size_t stackPushes(Instruction instruction) {
+    switch (instruction) {
+        case Instruction::SET_HEALTH:
+        case Instruction::PLAY_SOUND:
+        case Instruction::SET_HEALTH_IMM:
+        case Instruction::PLAY_SOUND_IMM: return 0;
+        default: return 1;
+    }
+}
+
+// Evaluates an arithmetic instruction (plain or _IMM) on known operands, the way
+// the VM would. Returns false when the result cannot be computed ahead of time:
+// division by zero, or a result that does not fit in an int.
+inline bool evaluateArithmetic(Instruction instruction, int operand1, int operand2, int& result) {
+    long long a = operand1, b = operand2, value;
+    switch (instruction) {
+        case Instruction::ADD:
+        case Instruction::ADD_IMM: value = a + b; break;
+        case Instruction::SUB:
+        case Instruction::SUB_IMM: value = a - b; break;
+        case Instruction::MUL:
+        case Instruction::MUL_IMM: value = a * b; break;
+        case Instruction::DIV:
+        case Instruction::DIV_IMM:
+            if (b == 0) return false;
+            value = a / b;
+            break;
+        default: return false;
+    }
+    if (value < INT_MIN || value > INT_MAX) {
+        return false;
+    }
+    result = static_cast<int>(value);
+    return true;
+}
+
+// A spell that has passed the load-time checks in verifier.hpp
+class VerifiedSpell;
+
+// A spell in the compact binary encoding of spell-bank.hpp
+struct CompactSpell;
+
+// Spells compiled to closures or build-time code by closure-compiler.hpp
+class CompiledSpell;
+template <typename... Ops>
+struct StaticSpell;
+
+// Per-opcode counters and timings, see profiler.hpp
+class SpellProfiler;
+
+// Native callbacks through which the VM reaches the game. Bound once when the
+// VM is constructed, so the game can decide where health lives and how sounds
+// are played without the VM knowing about either.
+struct SpellHost {
+    void* user; // Passed back to every callback
+    bool (*getHealth)(void* user, int wizardId, int& health); // false if there is no such wizard
+    bool (*setHealth)(void* user, int wizardId, int health);  // false if there is no such wizard
+    void (*playSound)(void* user, int soundId);
+};
+
+// Things the VM used to print while interpreting
+enum class TraceEvent {
+    SPELL_FINISHED,      // value unused
+    INVALID_WIZARD_ID,   // value is the wizard ID
+    UNKNOWN_INSTRUCTION  // value is the instruction
+};
+
+// Optional receiver for TraceEvents. The default sink has no callback, so
+// interpreting a spell does no I/O at all.
+struct SpellTraceSink {
+    void* user;
+    void (*trace)(void* user, TraceEvent event, int value);
+};
+
+// Reproduces the original console messages
+inline SpellTraceSink consoleTraceSink() {
+    return {nullptr, [](void*, TraceEvent event, int value) {
+        switch (event) {
+            case TraceEvent::SPELL_FINISHED:
+                std::cout << "Spell execution finished." << std::endl;
+                break;
+            case TraceEvent::INVALID_WIZARD_ID:
+                std::cerr << "Error: Invalid wizard ID: " << value << std::endl;
+                break;
+            case TraceEvent::UNKNOWN_INSTRUCTION:
+                std::cerr << "Error: Unknown instruction." << std::endl;
+                break;
+        }
+    }};
+}
+
+// Our simple stack-based Virtual Machine for spells
+class VM {
+public:
+    // A VM bound to its own wizard table, initialized with two wizards
+    explicit VM(const SpellTraceSink& trace = SpellTraceSink{nullptr, nullptr})
+        : wizardHealths_{100, 80}, host_(ownTable()), trace_(trace) {
+        host_.user = this;
+        stack_.reserve(maxStackSize_); // interpret() never allocates after this
+    }
+
+    // A VM that reaches the game only through `host`
+    VM(const SpellHost& host, const SpellTraceSink& trace = SpellTraceSink{nullptr, nullptr})
+        : host_(host), trace_(trace) {
+        stack_.reserve(maxStackSize_);
+    }
+
+    // Copies of a VM bound to its own table stay bound to their own copy
+    VM(const VM& other)
+        : stack_(other.stack_), wizardHealths_(other.wizardHealths_), host_(other.host_), trace_(other.trace_),
+          profiler_(other.profiler_) {
+        stack_.reserve(maxStackSize_);
+        if (other.usesOwnTable()) host_.user = this;
+    }
+
+    VM& operator=(const VM& other) {
+        stack_ = other.stack_;
+        wizardHealths_ = other.wizardHealths_;
+        host_ = other.host_;
+        trace_ = other.trace_;
+        profiler_ = other.profiler_;
+        if (other.usesOwnTable()) host_.user = this;
+        return *this;
+    }
+
+    // Runs a spell with full checking. Game state is reached only through the
+    // host callbacks, and nothing is allocated or printed unless a trace sink
+    // was given.
+    void interpret(const std::vector<Bytecode>& bytecode) {
+        if (profiler_) {
+            size_t i = 0;
+            interpretProfiled([&](Bytecode& instruction) {
+                if (i == bytecode.size()) return false;
+                instruction = bytecode[i++];
+                return true;
+            });
+            return;
+        }
+
+        stack_.clear(); // Clear the stack before interpreting a new spell
+
+        for (size_t i = 0; i < bytecode.size(); ++i) {
+            if (!execute(bytecode[i])) {
+                return;
+            }
+        }
+
+        trace(TraceEvent::SPELL_FINISHED, 0);
+    }
+
+    // Same as interpret(), but reads the compact encoding in place, one
+    // instruction at a time. Defined in spell-bank.hpp.
+    void interpret(const CompactSpell& spell);
+
+    // Runs a spell compiled by compileSpell() or written as a StaticSpell.
+    // Defined in closure-compiler.hpp.
+    void run(const CompiledSpell& spell);
+    template <typename... Ops>
+    void run(const StaticSpell<Ops...>& spell);
+
+    // Unchecked fast path for spells proven safe by verifySpell(). Performs no
+    // stack or wizard ID validation and no output. Defined in verifier.hpp.
+    void runVerified(const VerifiedSpell& spell);
+
+    // Switches profiling of interpret() on (with a profiler) or off (nullptr)
+    // at any time. The profiler must outlive its use by this VM.
+    void setProfiler(SpellProfiler* profiler) {
+        profiler_ = profiler;
+    }
+
+    SpellProfiler* profiler() const {
+        return profiler_;
+    }
+
+    // True unless the VM was constructed with a SpellHost
+    bool usesOwnTable() const {
+        return host_.user == this;
+    }
+
+    // Get the current health of all wizards in the VM's own table
+    void printWizardHealth() const {
+        for (size_t i = 0; i < wizardHealths_.size(); ++i) {
+            std::cout << "Wizard " << i << " Health: " << wizardHealths_[i] << std::endl;
+        }
+    }
+
+    const std::vector<int> &getWizardHealths() const {
+        return wizardHealths_;
+    }
+
+    std::vector<int> &getStack() {
+        return stack_;
+    }
+
+    static constexpr size_t maxStackSize() {
+        return maxStackSize_;
+    }
+
+    void printStack() const {
+        if (stack_.empty()) {
+            std::cout << "[Empty]" << std::endl;
+        } else {
+            for (int value : stack_) {
+                std::cout << value << " ";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+private:
+    // interpret() with every instruction timed and counted. `next` fills in
+    // the next instruction and returns false at the end of the spell. Defined
+    // in profiler.hpp.
+    template <typename NextInstruction>
+    void interpretProfiled(NextInstruction next);
+
+    // Executes one instruction with full checking. Returns false if the
+    // instruction is unknown and the spell must stop.
+    bool execute(const Bytecode& instruction) {
+#ifdef DEBUG
+        // Debug: Print the current instruction and stack state
+        std::cout << "Executing Instruction: " << instructionToString(instruction.instruction)
+                  << " (Argument: " << instruction.argument << ")" << std::endl;
+        std::cout << "Stack before execution: ";
+        printStack();
+#endif
+
+        switch (instruction.instruction) {
+            case Instruction::LITERAL:
+                push(instruction.argument); // Push the literal value onto the stack
+                break;
+            case Instruction::ADD: {
+                int operand2 = pop();
+                int operand1 = pop();
+                push(operand1 + operand2); // Pop two, add, push
+                break;
+            }
+            case Instruction::SUB: {
+                int operand2 = pop();
+                int operand1 = pop();
+                push(operand1 - operand2);
+                break;
+            }
+            case Instruction::MUL: {
+                int operand2 = pop();
+                int operand1 = pop();
+                push(operand1 * operand2);
+                break;
+            }
+            case Instruction::DIV: {
+                int operand2 = pop();
+                int operand1 = pop();
+                if (operand2 == 0) {
+                    throw std::runtime_error("Division by zero!");
+                }
+                push(operand1 / operand2);
+                break;
+            }
+            case Instruction::SET_HEALTH: {
+                int health = pop();
+                int wizardId = pop();
+                setHealth(wizardId, health);
+                break;
+            }
+            case Instruction::GET_HEALTH:
+                getHealth(pop());
+                break;
+            case Instruction::PLAY_SOUND:
+                playSound(pop());
+                break;
+            case Instruction::GET_HEALTH_IMM:
+                getHealth(instruction.argument);
+                break;
+            case Instruction::SET_HEALTH_IMM:
+                setHealth(instruction.argument, pop());
+                break;
+            case Instruction::ADD_IMM:
+                push(pop() + instruction.argument);
+                break;
+            case Instruction::SUB_IMM:
+                push(pop() - instruction.argument);
+                break;
+            case Instruction::MUL_IMM:
+                push(pop() * instruction.argument);
+                break;
+            case Instruction::DIV_IMM: {
+                int operand1 = pop();
+                if (instruction.argument == 0) {
+                    throw std::runtime_error("Division by zero!");
+                }
+                push(operand1 / instruction.argument);
+                break;
+            }
+            case Instruction::PLAY_SOUND_IMM:
+                playSound(instruction.argument);
+                break;
+            default:
+                trace(TraceEvent::UNKNOWN_INSTRUCTION, static_cast<int>(instruction.instruction));
+                return false;
+        }
+
+#ifdef DEBUG
+        // Debug: Print the stack state after execution
+        std::cout << "Stack after execution: ";
+        printStack();
+        std::cout << std::endl;
+#endif
+        return true;
+    }
+
+    // Pushes the health of a wizard, or nothing if the host has no such wizard
+    void getHealth(int wizardId) {
+        int health;
+        if (host_.getHealth(host_.user, wizardId, health)) {
+            push(health); // Push the health of the specified wizard onto the stack
+#ifdef DEBUG
+            std::cout << "Pushed Wizard " << wizardId << " health (" << health << ") onto the stack." << std::endl;
+#endif
+        } else {
+            trace(TraceEvent::INVALID_WIZARD_ID, wizardId);
+        }
+    }
+
+    void setHealth(int wizardId, int health) {
+        if (host_.setHealth(host_.user, wizardId, health)) {
+#ifdef DEBUG
+            std::cout << "Wizard " << wizardId << " health set to " << health << std::endl;
+#endif
+        } else {
+            trace(TraceEvent::INVALID_WIZARD_ID, wizardId);
+        }
+    }
+
+    void playSound(int soundId) {
+#ifdef DEBUG
+        std::cout << "Playing sound with ID: " << soundId << std::endl;
+#endif
+        if (host_.playSound) {
+            host_.playSound(host_.user, soundId);
+        }
+    }
+
+    void trace(TraceEvent event, int value) {
+        if (trace_.trace) {
+            trace_.trace(trace_.user, event, value);
+        }
+    }
+
+    // The fast paths index wizardHealths_ directly, so they cannot honour a host
+    void requireOwnTable() const {
+        if (!usesOwnTable()) {
+            throw std::logic_error("This execution engine needs a VM bound to its own wizard table");
+        }
+    }
+
+    // Host bindings for the VM's own wizardHealths_; `user` is the VM
+    static SpellHost ownTable() {
+        SpellHost host;
+        host.user = nullptr;
+        host.getHealth = [](void* user, int wizardId, int& health) {
+            std::vector<int>& healths = static_cast<VM*>(user)->wizardHealths_;
+            if (wizardId < 0 || wizardId >= static_cast<int>(healths.size())) return false;
+            health = healths[wizardId];
+            return true;
+        };
+        host.setHealth = [](void* user, int wizardId, int health) {
+            std::vector<int>& healths = static_cast<VM*>(user)->wizardHealths_;
+            if (wizardId < 0 || wizardId >= static_cast<int>(healths.size())) return false;
+            healths[wizardId] = health; // Set the health of the specified wizard
+            return true;
+        };
+        host.playSound = nullptr; // Sounds are only simulated
+        return host;
+    }
+
+    void push(int value) {
+        if (stack_.size() >= maxStackSize_) {
+            throw std::runtime_error("Stack overflow!"); // Prevent stack overflow
+        }
+        stack_.push_back(value); // Push a value onto the stack
+    }
+
+    int pop() {
+        if (stack_.empty()) {
+            throw std::runtime_error("Stack underflow!"); // Ensure the stack is not empty before popping
+        }
+        int value = stack_.back();
+        stack_.pop_back();
+        return value; // Pop a value from the stack
+    }
+
+    std::vector<int> stack_; // The operand stack for our VM
+    std::vector<int> wizardHealths_; // Simulate game state (wizard health) when no host is bound
+    SpellHost host_;
+    SpellTraceSink trace_;
+    SpellProfiler* profiler_ = nullptr;
+    static const size_t maxStackSize_ = 128; // Limit the stack size
+};
+
+// Defines VM::interpretProfiled(), which interpret() needs in every translation unit
+#include "profiler.hpp"
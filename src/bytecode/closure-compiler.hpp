@@ -0,0 +1,352 @@
+#pragma once
+
+#include <deque>
+#include <stdexcept>
+#include <vector>
+#include "bytecode.hpp"
+#include "verifier.hpp"
+
+// Closure compilation
+// -------------------
+// Instead of interpreting instructions, compileSpell() rebuilds the expression
+// trees hidden in the stack code and turns every tree node into a "closure":
+// a function pointer bound to its immediate argument and child nodes. Spell 2
+//
+//   LITERAL 0, LITERAL 0, GET_HEALTH, LITERAL 10, ADD, SET_HEALTH
+//
+// becomes setHealth[0](addImm[10](getHealth[0])). Running it is three direct
+// calls through pre-bound pointers: no dispatch switch and no operand stack.
+
+// What a compiled closure can touch while it runs
+struct ClosureContext {
+    int* healths;
+    int* temps; // Values spilled before a SET_HEALTH could change them
+    int* stack; // Values the spell leaves on the VM stack
+};
+
+struct ClosureNode;
+using ClosureFn = int (*)(const ClosureNode& node, const ClosureContext& context);
+
+struct ClosureNode {
+    ClosureFn fn;
+    int argument;
+    const ClosureNode* a;
+    const ClosureNode* b;
+};
+
+namespace closures {
+
+inline int eval(const ClosureNode* node, const ClosureContext& context) { return node->fn(*node, context); }
+
+inline int constant(const ClosureNode& node, const ClosureContext&) { return node.argument; }
+inline int getHealth(const ClosureNode& node, const ClosureContext& context) { return context.healths[node.argument]; }
+inline int loadTemp(const ClosureNode& node, const ClosureContext& context) { return context.temps[node.argument]; }
+
+// Operands are evaluated into locals to keep the left-to-right order of the stack code
+inline int add(const ClosureNode& node, const ClosureContext& context) {
+    int a = eval(node.a, context);
+    int b = eval(node.b, context);
+    return a + b;
+}
+inline int sub(const ClosureNode& node, const ClosureContext& context) {
+    int a = eval(node.a, context);
+    int b = eval(node.b, context);
+    return a - b;
+}
+inline int mul(const ClosureNode& node, const ClosureContext& context) {
+    int a = eval(node.a, context);
+    int b = eval(node.b, context);
+    return a * b;
+}
+inline int div(const ClosureNode& node, const ClosureContext& context) {
+    int a = eval(node.a, context);
+    int b = eval(node.b, context);
+    return a / b; // The verifier proved b is a non-zero constant
+}
+
+inline int addImm(const ClosureNode& node, const ClosureContext& context) { return eval(node.a, context) + node.argument; }
+inline int subImm(const ClosureNode& node, const ClosureContext& context) { return eval(node.a, context) - node.argument; }
+inline int mulImm(const ClosureNode& node, const ClosureContext& context) { return eval(node.a, context) * node.argument; }
+inline int divImm(const ClosureNode& node, const ClosureContext& context) { return eval(node.a, context) / node.argument; }
+
+// Statements; their return value is ignored
+inline int setHealth(const ClosureNode& node, const ClosureContext& context) {
+    context.healths[node.argument] = eval(node.a, context);
+    return 0;
+}
+inline int storeTemp(const ClosureNode& node, const ClosureContext& context) {
+    context.temps[node.argument] = eval(node.a, context);
+    return 0;
+}
+inline int push(const ClosureNode& node, const ClosureContext& context) {
+    context.stack[node.argument] = eval(node.a, context);
+    return 0;
+}
+
+} // namespace closures
+
+// A spell compiled to closures. Nodes point at each other, so it can be moved
+// (which keeps the deque's elements in place) but not copied.
+class CompiledSpell {
+public:
+    CompiledSpell(CompiledSpell&&) = default;
+    CompiledSpell& operator=(CompiledSpell&&) = default;
+    CompiledSpell(const CompiledSpell&) = delete;
+    CompiledSpell& operator=(const CompiledSpell&) = delete;
+
+    size_t statementCount() const { return statements_.size(); }
+    size_t finalStackDepth() const { return finalStackDepth_; }
+
+private:
+    friend CompiledSpell compileSpell(const VerifiedSpell& spell);
+    friend class VM;
+    CompiledSpell() = default;
+
+    std::deque<ClosureNode> nodes_; // Stable addresses while growing
+    std::vector<const ClosureNode*> statements_;
+    size_t tempCount_ = 0;
+    size_t finalStackDepth_ = 0;
+    size_t wizardCount_ = 0;
+};
+
+// Compiles a verified spell. Verification guarantees wizard IDs and divisors
+// are constants, so they become bound arguments rather than nodes.
+inline CompiledSpell compileSpell(const VerifiedSpell& verified) {
+    // An expression that will be on the stack at this point of the spell
+    struct Pending {
+        const ClosureNode* node;
+        bool readsHealth; // Must be evaluated before the next SET_HEALTH
+        bool constant;
+        int value;
+    };
+
+    CompiledSpell spell;
+    spell.wizardCount_ = verified.wizardCount();
+    std::vector<Pending> stack;
+
+    auto node = [&spell](ClosureFn fn, int argument, const ClosureNode* a = nullptr, const ClosureNode* b = nullptr) {
+        spell.nodes_.push_back({fn, argument, a, b});
+        return &spell.nodes_.back();
+    };
+    auto pop = [&stack]() {
+        Pending top = stack.back();
+        stack.pop_back();
+        return top;
+    };
+    auto pushConstant = [&](int value) {
+        stack.push_back({node(closures::constant, value), false, true, value});
+    };
+    // Pending expr op value, with value known at compile time
+    auto applyImmediate = [&](Instruction instruction, Pending a, int value) {
+        int folded;
+        if (a.constant && evaluateArithmetic(instruction, a.value, value, folded)) {
+            pushConstant(folded);
+            return;
+        }
+        ClosureFn fn;
+        switch (instruction) {
+            case Instruction::ADD:
+            case Instruction::ADD_IMM: fn = closures::addImm; break;
+            case Instruction::SUB:
+            case Instruction::SUB_IMM: fn = closures::subImm; break;
+            case Instruction::MUL:
+            case Instruction::MUL_IMM: fn = closures::mulImm; break;
+            default: fn = closures::divImm; break;
+        }
+        stack.push_back({node(fn, value, a.node), a.readsHealth, false, 0});
+    };
+    // Values read from the current health must not see the upcoming write
+    auto spillHealthReads = [&]() {
+        for (Pending& pending : stack) {
+            if (pending.readsHealth) {
+                int temp = static_cast<int>(spell.tempCount_++);
+                spell.statements_.push_back(node(closures::storeTemp, temp, pending.node));
+                pending = {node(closures::loadTemp, temp), false, false, 0};
+            }
+        }
+    };
+    auto setHealth = [&](int wizardId, Pending health) {
+        spillHealthReads();
+        spell.statements_.push_back(node(closures::setHealth, wizardId, health.node));
+    };
+
+    for (const Bytecode& instruction : verified.code()) {
+        switch (instruction.instruction) {
+            case Instruction::LITERAL:
+                pushConstant(instruction.argument);
+                break;
+            case Instruction::ADD:
+            case Instruction::SUB:
+            case Instruction::MUL:
+            case Instruction::DIV: {
+                Pending b = pop();
+                Pending a = pop();
+                if (b.constant) {
+                    applyImmediate(instruction.instruction, a, b.value);
+                    break;
+                }
+                ClosureFn fn = instruction.instruction == Instruction::ADD ? closures::add
+                             : instruction.instruction == Instruction::SUB ? closures::sub
+                             : instruction.instruction == Instruction::MUL ? closures::mul
+                             : closures::div;
+                stack.push_back({node(fn, 0, a.node, b.node), a.readsHealth || b.readsHealth, false, 0});
+                break;
+            }
+            case Instruction::ADD_IMM:
+            case Instruction::SUB_IMM:
+            case Instruction::MUL_IMM:
+            case Instruction::DIV_IMM:
+                applyImmediate(instruction.instruction, pop(), instruction.argument);
+                break;
+            case Instruction::GET_HEALTH:
+                stack.push_back({node(closures::getHealth, pop().value), true, false, 0});
+                break;
+            case Instruction::GET_HEALTH_IMM:
+                stack.push_back({node(closures::getHealth, instruction.argument), true, false, 0});
+                break;
+            case Instruction::SET_HEALTH: {
+                Pending health = pop();
+                setHealth(pop().value, health);
+                break;
+            }
+            case Instruction::SET_HEALTH_IMM:
+                setHealth(instruction.argument, pop());
+                break;
+            case Instruction::PLAY_SOUND:
+                // Compiled spells run on the VM's own table, which has no sound
+                // callback, and every expression is pure: the ID is discarded
+                pop();
+                break;
+            case Instruction::PLAY_SOUND_IMM:
+                break;
+        }
+    }
+
+    // Whatever is left becomes the VM stack, as with interpret()
+    for (size_t slot = 0; slot < stack.size(); ++slot) {
+        spell.statements_.push_back(node(closures::push, static_cast<int>(slot), stack[slot].node));
+    }
+    spell.finalStackDepth_ = stack.size();
+    return spell;
+}
+
+inline void VM::run(const CompiledSpell& spell) {
+    requireOwnTable();
+    if (spell.wizardCount_ > wizardHealths_.size()) {
+        throw std::runtime_error("Spell was verified for more wizards than this VM has!");
+    }
+    // Temps live just past the final stack, so running never allocates once warm
+    stack_.resize(spell.finalStackDepth_ + spell.tempCount_);
+    ClosureContext context{wizardHealths_.data(), stack_.data() + spell.finalStackDepth_, stack_.data()};
+    for (const ClosureNode* statement : spell.statements_) {
+        statement->fn(*statement, context);
+    }
+    stack_.resize(spell.finalStackDepth_);
+}
+
+// Build-time spells
+// -----------------
+// Spells known when the game is compiled can skip even the closures: writing
+//
+//   using Heal10 = StaticSpell<Op<Instruction::LITERAL, 0>, Op<Instruction::LITERAL, 0>,
+//                              Op<Instruction::GET_HEALTH>, Op<Instruction::LITERAL, 10>,
+//                              Op<Instruction::ADD>, Op<Instruction::SET_HEALTH>>;
+//
+// makes the compiler expand the spell into straight-line code over a local
+// array it can keep in registers. Stack underflow and overflow are compile
+// errors. Wizard IDs are range-checked, which the optimizer folds away since
+// they are constants; an invalid one is a bug in the game and throws.
+
+template <Instruction I, int Argument = 0>
+struct Op {};
+
+namespace static_spells {
+
+constexpr size_t maxOf(size_t a, size_t b) { return a > b ? a : b; }
+
+// Executes one instruction; `sp` points one past the top of the stack
+template <Instruction I, int Argument>
+inline void step(int* sp, int* healths, int wizardCount) {
+    auto validWizard = [wizardCount](int wizardId) { return wizardId >= 0 && wizardId < wizardCount; };
+    switch (I) {
+        case Instruction::LITERAL: sp[0] = Argument; break;
+        case Instruction::ADD: sp[-2] += sp[-1]; break;
+        case Instruction::SUB: sp[-2] -= sp[-1]; break;
+        case Instruction::MUL: sp[-2] *= sp[-1]; break;
+        case Instruction::DIV:
+            if (sp[-1] == 0) throw std::runtime_error("Division by zero!");
+            sp[-2] /= sp[-1];
+            break;
+        case Instruction::ADD_IMM: sp[-1] += Argument; break;
+        case Instruction::SUB_IMM: sp[-1] -= Argument; break;
+        case Instruction::MUL_IMM: sp[-1] *= Argument; break;
+        case Instruction::DIV_IMM:
+            if (Argument == 0) throw std::runtime_error("Division by zero!");
+            sp[-1] /= Argument;
+            break;
+        case Instruction::SET_HEALTH:
+        case Instruction::SET_HEALTH_IMM: {
+            int wizardId = I == Instruction::SET_HEALTH ? sp[-2] : Argument;
+            if (!validWizard(wizardId)) {
+                throw std::runtime_error("Invalid wizard ID in build-time spell");
+            }
+            healths[wizardId] = sp[-1];
+            break;
+        }
+        case Instruction::GET_HEALTH:
+        case Instruction::GET_HEALTH_IMM: {
+            int wizardId = I == Instruction::GET_HEALTH ? sp[-1] : Argument;
+            if (!validWizard(wizardId)) {
+                throw std::runtime_error("Invalid wizard ID in build-time spell");
+            }
+            sp[I == Instruction::GET_HEALTH ? -1 : 0] = healths[wizardId];
+            break;
+        }
+        case Instruction::PLAY_SOUND:
+        case Instruction::PLAY_SOUND_IMM:
+            break;
+    }
+}
+
+template <size_t Depth, typename... Ops>
+struct Exec;
+
+template <size_t Depth>
+struct Exec<Depth> {
+    static const size_t finalDepth = Depth;
+    static const size_t maxDepth = Depth;
+    static void run(int*, int*, int) {}
+};
+
+template <size_t Depth, Instruction I, int Argument, typename... Rest>
+struct Exec<Depth, Op<I, Argument>, Rest...> {
+    static_assert(Depth >= stackPops(I), "Stack underflow!");
+    using Next = Exec<Depth - stackPops(I) + stackPushes(I), Rest...>;
+    static const size_t finalDepth = Next::finalDepth;
+    static const size_t maxDepth = maxOf(Depth, Next::maxDepth);
+
+    static void run(int* stack, int* healths, int wizardCount) {
+        step<I, Argument>(stack + Depth, healths, wizardCount);
+        Next::run(stack, healths, wizardCount);
+    }
+};
+
+} // namespace static_spells
+
+template <typename... Ops>
+struct StaticSpell {
+    using Exec = static_spells::Exec<0, Ops...>;
+    static_assert(Exec::maxDepth <= VM::maxStackSize(), "Stack overflow!");
+
+    static void execute(int* healths, int wizardCount, std::vector<int>& stack) {
+        int values[Exec::maxDepth > 0 ? Exec::maxDepth : 1];
+        Exec::run(values, healths, wizardCount);
+        stack.assign(values, values + Exec::finalDepth);
+    }
+};
+
+template <typename... Ops>
+inline void VM::run(const StaticSpell<Ops...>&) {
+    requireOwnTable();
+    StaticSpell<Ops...>::execute(wizardHealths_.data(), static_cast<int>(wizardHealths_.size()), stack_);
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "bytecode.hpp"
+#include "verifier.hpp"
+
+// What optimizeSpell() did to one spell
+struct OptimizationReport {
+    size_t originalInstructions = 0;
+    size_t optimizedInstructions = 0;
+    size_t constantsFolded = 0;        // Arithmetic on constants computed at load time
+    size_t superinstructionsFused = 0; // LITERAL + instruction pairs turned into one _IMM op
+    size_t identitiesRemoved = 0;      // Operations like ADD 0 or MUL 1 dropped entirely
+
+    size_t removed() const { return originalInstructions - optimizedInstructions; }
+};
+
+// Peephole optimizer for spells. Works in one pass, emitting into a new
+// program while tracking, for every stack slot, whether it was pushed by a
+// LITERAL that is still in the output. That is enough to:
+//   * fold arithmetic on constants:   LITERAL 5, LITERAL 3, ADD -> LITERAL 8
+//   * fuse a literal into the op:     LITERAL 10, ADD            -> ADD_IMM 10
+//                                     LITERAL 0, GET_HEALTH      -> GET_HEALTH_IMM 0
+//   * fuse a literal wizard ID pushed earlier in the spell:
+//                                     LITERAL 0, ..., SET_HEALTH -> ..., SET_HEALTH_IMM 0
+//   * merge and drop immediates:      ADD_IMM 3, ADD_IMM 4 -> ADD_IMM 7; MUL_IMM 1 -> (nothing)
+// Division by zero is never folded, so it still fails at runtime. Spells that
+// underflow or contain an unknown instruction are rejected with
+// std::runtime_error.
+//
+// GET_HEALTH pushes nothing for a wizard ID the VM does not have, so in
+// unverified bytecode the slots below it may not be where the optimizer
+// thinks: a SET_HEALTH is then never fused with a wizard ID pushed before a
+// GET_HEALTH. A VerifiedSpell has only valid IDs and is optimized fully.
+namespace optimizer {
+
+inline std::vector<Bytecode> optimize(const std::vector<Bytecode>& bytecode, OptimizationReport* report,
+                                      bool wizardIdsValid) {
+    OptimizationReport stats;
+    stats.originalInstructions = bytecode.size();
+
+    std::vector<Bytecode> out;
+    out.reserve(bytecode.size());
+    // Per stack slot: index in `out` of the LITERAL that pushed it, or -1
+    std::vector<long> literalAt;
+
+    // True if the slot `depth` below the top was pushed by the LITERAL sitting
+    // at the same distance from the end of the output
+    auto isTrailingLiteral = [&](size_t depth) {
+        return literalAt.size() > depth && out.size() > depth &&
+               literalAt[literalAt.size() - 1 - depth] == static_cast<long>(out.size() - 1 - depth);
+    };
+
+    // True if a GET_HEALTH in the output after index `from` may have pushed
+    // nothing, moving every slot below it
+    auto readsHealthAfter = [&](size_t from) {
+        if (wizardIdsValid) {
+            return false;
+        }
+        for (size_t j = from + 1; j < out.size(); ++j) {
+            if (out[j].instruction == Instruction::GET_HEALTH || out[j].instruction == Instruction::GET_HEALTH_IMM) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    auto isIdentity = [](Instruction instruction, int argument) {
+        switch (instruction) {
+            case Instruction::ADD_IMM:
+            case Instruction::SUB_IMM: return argument == 0;
+            case Instruction::MUL_IMM:
+            case Instruction::DIV_IMM: return argument == 1;
+            default: return false;
+        }
+    };
+
+    // Emits `instruction argument` for an arithmetic _IMM op applied to the top slot
+    auto emitImmediate = [&](Instruction instruction, int argument) {
+        int value;
+        if (isIdentity(instruction, argument)) {
+            ++stats.identitiesRemoved;
+            return;
+        }
+        if (isTrailingLiteral(0) && evaluateArithmetic(instruction, out.back().argument, argument, value)) {
+            out.back().argument = value;
+            ++stats.constantsFolded;
+            return;
+        }
+        if (!out.empty() && out.back().instruction == instruction && instruction != Instruction::DIV_IMM) {
+            // Two consecutive immediates on the same slot: (x + a) + b == x + (a + b)
+            Instruction combine = instruction == Instruction::MUL_IMM ? Instruction::MUL : Instruction::ADD;
+            if (evaluateArithmetic(combine, out.back().argument, argument, value)) {
+                ++stats.constantsFolded;
+                if (isIdentity(instruction, value)) {
+                    out.pop_back();
+                    ++stats.identitiesRemoved;
+                } else {
+                    out.back().argument = value;
+                }
+                return;
+            }
+        }
+        out.push_back({instruction, argument});
+        literalAt.back() = -1;
+    };
+
+    for (size_t i = 0; i < bytecode.size(); ++i) {
+        const Bytecode& instruction = bytecode[i];
+        if (literalAt.size() < stackPops(instruction.instruction)) {
+            throw std::runtime_error("Cannot optimize spell: stack underflow at instruction " + std::to_string(i));
+        }
+
+        switch (instruction.instruction) {
+            case Instruction::LITERAL:
+                literalAt.push_back(static_cast<long>(out.size()));
+                out.push_back(instruction);
+                break;
+            case Instruction::ADD:
+            case Instruction::SUB:
+            case Instruction::MUL:
+            case Instruction::DIV: {
+                int value;
+                if (isTrailingLiteral(0) && isTrailingLiteral(1) &&
+                    evaluateArithmetic(instruction.instruction, out[out.size() - 2].argument, out.back().argument, value)) {
+                    out.pop_back();
+                    literalAt.pop_back();
+                    out.back().argument = value;
+                    ++stats.constantsFolded;
+                } else if (isTrailingLiteral(0) &&
+                           !(instruction.instruction == Instruction::DIV && out.back().argument == 0)) {
+                    int argument = out.back().argument;
+                    out.pop_back();
+                    literalAt.pop_back();
+                    ++stats.superinstructionsFused;
+                    // ADD..DIV and ADD_IMM..DIV_IMM are declared in the same order
+                    emitImmediate(static_cast<Instruction>(static_cast<int>(Instruction::ADD_IMM) +
+                                                           static_cast<int>(instruction.instruction) -
+                                                           static_cast<int>(Instruction::ADD)),
+                                  argument);
+                } else {
+                    out.push_back(instruction);
+                    literalAt.pop_back();
+                    literalAt.back() = -1;
+                }
+                break;
+            }
+            case Instruction::ADD_IMM:
+            case Instruction::SUB_IMM:
+            case Instruction::MUL_IMM:
+            case Instruction::DIV_IMM:
+                emitImmediate(instruction.instruction, instruction.argument);
+                break;
+            case Instruction::GET_HEALTH:
+                if (isTrailingLiteral(0)) {
+                    out.back().instruction = Instruction::GET_HEALTH_IMM;
+                    ++stats.superinstructionsFused;
+                } else {
+                    out.push_back(instruction);
+                }
+                literalAt.back() = -1;
+                break;
+            case Instruction::SET_HEALTH: {
+                literalAt.pop_back(); // Health amount
+                long idAt = literalAt.back();
+                literalAt.pop_back();
+                if (idAt >= 0 && !readsHealthAfter(static_cast<size_t>(idAt))) {
+                    // Only the consumed health slot was pushed after the ID, so
+                    // removing its LITERAL cannot disturb any live slot
+                    int wizardId = out[idAt].argument;
+                    out.erase(out.begin() + idAt);
+                    out.push_back({Instruction::SET_HEALTH_IMM, wizardId});
+                    ++stats.superinstructionsFused;
+                } else {
+                    out.push_back(instruction);
+                }
+                break;
+            }
+            case Instruction::PLAY_SOUND:
+                if (isTrailingLiteral(0)) {
+                    out.back().instruction = Instruction::PLAY_SOUND_IMM;
+                    ++stats.superinstructionsFused;
+                } else {
+                    out.push_back(instruction);
+                }
+                literalAt.pop_back();
+                break;
+            case Instruction::GET_HEALTH_IMM:
+                out.push_back(instruction);
+                literalAt.push_back(-1);
+                break;
+            case Instruction::SET_HEALTH_IMM:
+                out.push_back(instruction);
+                literalAt.pop_back();
+                break;
+            case Instruction::PLAY_SOUND_IMM:
+                out.push_back(instruction);
+                break;
+            default:
+                throw std::runtime_error("Cannot optimize spell: unknown instruction at " + std::to_string(i));
+        }
+    }
+
+    stats.optimizedInstructions = out.size();
+    if (report) {
+        *report = stats;
+    }
+    return out;
+}
+
+} // namespace optimizer
+
+inline std::vector<Bytecode> optimizeSpell(const std::vector<Bytecode>& bytecode,
+                                           OptimizationReport* report = nullptr) {
+    return optimizer::optimize(bytecode, report, false);
+}
+
+// The result still has to be verified again before VM::runVerified() takes it
+inline std::vector<Bytecode> optimizeSpell(const VerifiedSpell& spell, OptimizationReport* report = nullptr) {
+    return optimizer::optimize(spell.code(), report, true);
+}
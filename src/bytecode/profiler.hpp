@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "bytecode.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Cheapest available timestamp: the TSC on x86, the virtual counter on
+// AArch64, nanoseconds from steady_clock elsewhere. Only differences between
+// two readings on the same thread are meaningful.
+inline std::uint64_t readCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    std::uint64_t value;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+inline const char* cycleCounterName() {
+#if defined(__x86_64__) || defined(__i386__)
+    return "rdtsc";
+#elif defined(__aarch64__)
+    return "cntvct";
+#else
+    return "steady_clock_ns";
+#endif
+}
+
+// Collects execution counts and cycles per instruction, per opcode pair and
+// per spell from VMs it is attached to with VM::setProfiler(). A VM without a
+// profiler pays one pointer check per spell; with one attached, every
+// instruction is timestamped.
+//
+// Spells are identified by a hash of their instructions, so the same spell is
+// recognized whether it comes from a vector or a spell bank. nameSpell() gives
+// a hash a readable name for the report.
+//
+// Not thread-safe: give each VM (e.g. each SpellScheduler worker) its own
+// profiler and merge() them afterwards.
+class SpellProfiler {
+public:
+    static const size_t opcodeCount = static_cast<size_t>(Instruction::PLAY_SOUND_IMM) + 1;
+
+    struct OpcodeStats {
+        std::uint64_t count = 0;
+        std::uint64_t cycles = 0;
+    };
+
+    struct SpellStats {
+        std::string name; // Empty unless given with nameSpell()
+        std::uint64_t calls = 0;
+        std::uint64_t instructions = 0;
+        std::uint64_t cycles = 0;
+    };
+
+    // One multiply per instruction over (instruction, argument) packed into a
+    // word, so hashing keeps up with the interpreter, then a final mix so the
+    // low bits depend on every instruction. Call finishHash() on the result.
+    static const std::uint64_t hashSeed = 14695981039346656037ull;
+    static std::uint64_t hashInstruction(std::uint64_t hash, const Bytecode& instruction) {
+        std::uint64_t word = static_cast<std::uint64_t>(instruction.instruction) << 32 |
+                             static_cast<std::uint32_t>(instruction.argument);
+        return (hash ^ word) * 0x9e3779b97f4a7c15ull;
+    }
+
+    static std::uint64_t finishHash(std::uint64_t hash) {
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        return hash ^ hash >> 33;
+    }
+
+    static std::uint64_t hashSpell(const std::vector<Bytecode>& bytecode) {
+        std::uint64_t hash = hashSeed;
+        for (const Bytecode& instruction : bytecode) {
+            hash = hashInstruction(hash, instruction);
+        }
+        return finishHash(hash);
+    }
+
+    void nameSpell(const std::vector<Bytecode>& bytecode, const std::string& name) {
+        spells_[hashSpell(bytecode)].name = name;
+    }
+
+    // Called by the VM after each instruction. `previous` is the instruction
+    // before it in the same spell, or -1 for the first one.
+    void recordInstruction(int previous, Instruction instruction, std::uint64_t cycles) {
+        size_t opcode = static_cast<size_t>(instruction);
+        if (opcode >= opcodeCount) {
+            return;
+        }
+        opcodes_[opcode].count++;
+        opcodes_[opcode].cycles += cycles;
+        if (previous >= 0) {
+            pairs_[previous * opcodeCount + opcode]++;
+        }
+    }
+
+    void recordSpell(std::uint64_t hash, std::uint64_t instructions, std::uint64_t cycles) {
+        SpellStats& spell = spells_[hash];
+        spell.calls++;
+        spell.instructions += instructions;
+        spell.cycles += cycles;
+    }
+
+    const OpcodeStats& opcode(Instruction instruction) const {
+        return opcodes_[static_cast<size_t>(instruction)];
+    }
+
+    std::uint64_t pairCount(Instruction first, Instruction second) const {
+        return pairs_[static_cast<size_t>(first) * opcodeCount + static_cast<size_t>(second)];
+    }
+
+    const std::unordered_map<std::uint64_t, SpellStats>& spells() const { return spells_; }
+
+    // Adds another profiler's numbers to this one
+    void merge(const SpellProfiler& other) {
+        for (size_t i = 0; i < opcodeCount; ++i) {
+            opcodes_[i].count += other.opcodes_[i].count;
+            opcodes_[i].cycles += other.opcodes_[i].cycles;
+        }
+        for (size_t i = 0; i < opcodeCount * opcodeCount; ++i) {
+            pairs_[i] += other.pairs_[i];
+        }
+        for (const auto& entry : other.spells_) {
+            SpellStats& spell = spells_[entry.first];
+            if (spell.name.empty()) spell.name = entry.second.name;
+            spell.calls += entry.second.calls;
+            spell.instructions += entry.second.instructions;
+            spell.cycles += entry.second.cycles;
+        }
+    }
+
+    // Clears all numbers but keeps spell names
+    void reset() {
+        std::fill(std::begin(opcodes_), std::end(opcodes_), OpcodeStats());
+        std::fill(std::begin(pairs_), std::end(pairs_), 0);
+        for (auto& entry : spells_) {
+            std::string name = entry.second.name;
+            entry.second = SpellStats();
+            entry.second.name = name;
+        }
+    }
+
+    // Writes the report as JSON. Opcodes with no executions are left out;
+    // pairs and spells are sorted with the most frequent first.
+    void writeJson(std::ostream& out) const {
+        out << "{\n  \"clock\": \"" << cycleCounterName() << "\",\n  \"opcodes\": [";
+        const char* separator = "\n";
+        for (size_t i = 0; i < opcodeCount; ++i) {
+            if (opcodes_[i].count == 0) continue;
+            out << separator << "    {\"opcode\": \"" << instructionToString(static_cast<Instruction>(i))
+                << "\", \"count\": " << opcodes_[i].count << ", \"cycles\": " << opcodes_[i].cycles << "}";
+            separator = ",\n";
+        }
+
+        std::vector<size_t> pairs;
+        for (size_t i = 0; i < opcodeCount * opcodeCount; ++i) {
+            if (pairs_[i]) pairs.push_back(i);
+        }
+        std::stable_sort(pairs.begin(), pairs.end(), [this](size_t a, size_t b) { return pairs_[a] > pairs_[b]; });
+        out << "\n  ],\n  \"pairs\": [";
+        separator = "\n";
+        for (size_t i : pairs) {
+            out << separator << "    {\"first\": \"" << instructionToString(static_cast<Instruction>(i / opcodeCount))
+                << "\", \"second\": \"" << instructionToString(static_cast<Instruction>(i % opcodeCount))
+                << "\", \"count\": " << pairs_[i] << "}";
+            separator = ",\n";
+        }
+
+        std::vector<std::pair<std::uint64_t, const SpellStats*>> spells;
+        for (const auto& entry : spells_) {
+            if (entry.second.calls) spells.push_back({entry.first, &entry.second});
+        }
+        std::sort(spells.begin(), spells.end(), [](const std::pair<std::uint64_t, const SpellStats*>& a,
+                                                   const std::pair<std::uint64_t, const SpellStats*>& b) {
+            return a.second->cycles != b.second->cycles ? a.second->cycles > b.second->cycles : a.first < b.first;
+        });
+        out << "\n  ],\n  \"spells\": [";
+        separator = "\n";
+        for (const auto& spell : spells) {
+            out << separator << "    {\"hash\": \"" << std::hex << spell.first << std::dec << "\", \"name\": \"";
+            writeEscaped(out, spell.second->name);
+            out << "\", \"calls\": " << spell.second->calls << ", \"instructions\": " << spell.second->instructions
+                << ", \"cycles\": " << spell.second->cycles << "}";
+            separator = ",\n";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+private:
+    static void writeEscaped(std::ostream& out, const std::string& text) {
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out << '\\' << c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                out << ' ';
+            } else {
+                out << c;
+            }
+        }
+    }
+
+    OpcodeStats opcodes_[opcodeCount];
+    std::uint64_t pairs_[opcodeCount * opcodeCount] = {}; // [first * opcodeCount + second]
+    std::unordered_map<std::uint64_t, SpellStats> spells_;
+};
+
+template <typename NextInstruction>
+inline void VM::interpretProfiled(NextInstruction next) {
+    stack_.clear();
+
+    std::uint64_t hash = SpellProfiler::hashSeed;
+    std::uint64_t instructions = 0;
+    std::uint64_t cycles = 0;
+    int previous = -1;
+
+    Bytecode instruction;
+    auto count = [&](std::uint64_t elapsed) {
+        profiler_->recordInstruction(previous, instruction.instruction, elapsed);
+        cycles += elapsed;
+        hash = SpellProfiler::hashInstruction(hash, instruction);
+        ++instructions;
+        previous = static_cast<int>(instruction.instruction);
+    };
+    // A spell that stops early is still recorded, so spell totals always add
+    // up to the opcode totals. The unexecuted rest is hashed so the spell keeps
+    // its hashSpell() identity, unless it cannot be decoded.
+    auto recordStopped = [&] {
+        try {
+            while (next(instruction)) {
+                hash = SpellProfiler::hashInstruction(hash, instruction);
+            }
+        } catch (const std::exception&) {
+        }
+        profiler_->recordSpell(SpellProfiler::finishHash(hash), instructions, cycles);
+    };
+
+    bool keepGoing = true;
+    try {
+        while (keepGoing && next(instruction)) {
+            // Timed only around execute(): fetching, e.g. decoding a
+            // CompactSpell, and the bookkeeping are left out
+            std::uint64_t start = readCycleCounter();
+            try {
+                keepGoing = execute(instruction);
+            } catch (...) {
+                count(readCycleCounter() - start);
+                throw;
+            }
+            count(readCycleCounter() - start);
+        }
+    } catch (...) {
+        recordStopped();
+        throw;
+    }
+
+    if (!keepGoing) {
+        recordStopped(); // Stopped on an unknown instruction
+        return;
+    }
+    profiler_->recordSpell(SpellProfiler::finishHash(hash), instructions, cycles);
+    trace(TraceEvent::SPELL_FINISHED, 0);
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "bytecode.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SPELL_BANK_MMAP 1
+#else
+#define SPELL_BANK_MMAP 0
+#endif
+
+// Compact spell encoding
+// ----------------------
+// Every instruction is one opcode byte (the Instruction value). Instructions
+// that use their argument (LITERAL and the _IMM superinstructions) follow it
+// with the argument as a zigzag varint, so small numbers of either sign take a
+// single byte. `ADD` is 1 byte instead of sizeof(Bytecode) == 8, `LITERAL 50`
+// is 2 bytes.
+//
+// Spell bank file
+// ---------------
+// All integers are little-endian uint32.
+//   magic "SPLB", version, spell count
+//   spell count x { offset, length }   offsets are from the start of the file
+//   encoded spells, back to back
+
+inline bool hasArgument(Instruction instruction) {
+    switch (instruction) {
+        case Instruction::LITERAL:
+        case Instruction::GET_HEALTH_IMM:
+        case Instruction::SET_HEALTH_IMM:
+        case Instruction::ADD_IMM:
+        case Instruction::SUB_IMM:
+        case Instruction::MUL_IMM:
+        case Instruction::DIV_IMM:
+        case Instruction::PLAY_SOUND_IMM: return true;
+        default: return false;
+    }
+}
+
+// A view of one encoded spell. It does not own its bytes; for spells loaded
+// from a SpellBank they point straight into the mapped file.
+struct CompactSpell {
+    const std::uint8_t* begin;
+    const std::uint8_t* end;
+
+    size_t size() const { return static_cast<size_t>(end - begin); }
+};
+
+inline void encodeSpell(const std::vector<Bytecode>& bytecode, std::vector<std::uint8_t>& out) {
+    for (const Bytecode& instruction : bytecode) {
+        out.push_back(static_cast<std::uint8_t>(instruction.instruction));
+        if (!hasArgument(instruction.instruction)) {
+            continue;
+        }
+        // Zigzag maps 0, -1, 1, -2, ... to 0, 1, 2, 3, ...
+        std::uint32_t value = (static_cast<std::uint32_t>(instruction.argument) << 1) ^
+                              static_cast<std::uint32_t>(instruction.argument >> 31);
+        while (value >= 0x80) {
+            out.push_back(static_cast<std::uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<std::uint8_t>(value));
+    }
+}
+
+// Decodes the instruction at `ip` and advances past it. Throws on truncated or
+// unknown input, since spell banks come from disk.
+inline Bytecode decodeInstruction(const std::uint8_t*& ip, const std::uint8_t* end) {
+    std::uint8_t opcode = *ip++;
+    if (opcode > static_cast<std::uint8_t>(Instruction::PLAY_SOUND_IMM)) {
+        throw std::runtime_error("Corrupt spell: unknown opcode " + std::to_string(opcode));
+    }
+    Bytecode instruction{static_cast<Instruction>(opcode), 0};
+    if (hasArgument(instruction.instruction)) {
+        std::uint32_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            if (ip == end || shift > 28) {
+                throw std::runtime_error("Corrupt spell: bad argument");
+            }
+            std::uint8_t byte = *ip++;
+            if (shift == 28 && (byte & 0x70)) {
+                // The fifth byte only has room for the top 4 bits of 32
+                throw std::runtime_error("Corrupt spell: bad argument");
+            }
+            value |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        instruction.argument = static_cast<int>((value >> 1) ^ (~(value & 1) + 1));
+    }
+    return instruction;
+}
+
+inline void VM::interpret(const CompactSpell& spell) {
+    if (profiler_) {
+        const std::uint8_t* ip = spell.begin;
+        interpretProfiled([&](Bytecode& instruction) {
+            if (ip == spell.end) return false;
+            instruction = decodeInstruction(ip, spell.end);
+            return true;
+        });
+        return;
+    }
+
+    stack_.clear(); // Clear the stack before interpreting a new spell
+
+    const std::uint8_t* ip = spell.begin;
+    while (ip != spell.end) {
+        if (!execute(decodeInstruction(ip, spell.end))) {
+            return;
+        }
+    }
+
+    trace(TraceEvent::SPELL_FINISHED, 0);
+}
+
+// Writes spells to a spell bank file that SpellBank can map.
+inline void writeSpellBank(const std::string& path, const std::vector<std::vector<Bytecode>>& spells) {
+    std::vector<std::uint8_t> file;
+    auto putU32 = [&file](std::uint32_t value, size_t at) {
+        for (int i = 0; i < 4; ++i) file[at + i] = static_cast<std::uint8_t>(value >> (8 * i));
+    };
+
+    size_t headerSize = 12 + 8 * spells.size();
+    file.resize(headerSize);
+    std::memcpy(file.data(), "SPLB", 4);
+    putU32(1, 4);
+    putU32(static_cast<std::uint32_t>(spells.size()), 8);
+    for (size_t i = 0; i < spells.size(); ++i) {
+        size_t offset = file.size();
+        encodeSpell(spells[i], file);
+        putU32(static_cast<std::uint32_t>(offset), 12 + 8 * i);
+        putU32(static_cast<std::uint32_t>(file.size() - offset), 16 + 8 * i);
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+    if (!out) {
+        throw std::runtime_error("Could not write spell bank: " + path);
+    }
+}
+
+// A spell bank mapped read-only into memory. Opening it only validates the
+// header and directory; spells are handed out as views into the mapping and
+// executed in place, so nothing is copied or decoded up front.
+class SpellBank {
+public:
+    explicit SpellBank(const std::string& path) {
+#if SPELL_BANK_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open spell bank: " + path);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error("Could not read spell bank: " + path);
+        }
+        size_ = static_cast<size_t>(info.st_size);
+        void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // The mapping keeps the file alive
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("Could not map spell bank: " + path);
+        }
+        data_ = static_cast<const std::uint8_t*>(mapping);
+#else
+        // No mmap on this platform: read the file once into memory instead
+        std::ifstream in(path, std::ios::binary);
+        fallback_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        if (fallback_.empty()) {
+            throw std::runtime_error("Could not read spell bank: " + path);
+        }
+        data_ = fallback_.data();
+        size_ = fallback_.size();
+#endif
+        try {
+            validate();
+        } catch (...) {
+            release();
+            throw;
+        }
+    }
+
+    ~SpellBank() { release(); }
+
+    SpellBank(const SpellBank&) = delete;
+    SpellBank& operator=(const SpellBank&) = delete;
+
+    size_t size() const { return count_; }
+    size_t bytes() const { return size_; }
+
+    CompactSpell spell(size_t index) const {
+        if (index >= count_) {
+            throw std::out_of_range("Spell bank has no spell " + std::to_string(index));
+        }
+        const std::uint8_t* entry = data_ + 12 + 8 * index;
+        const std::uint8_t* begin = data_ + readU32(entry);
+        return {begin, begin + readU32(entry + 4)};
+    }
+
+private:
+    static std::uint32_t readU32(const std::uint8_t* at) {
+        return static_cast<std::uint32_t>(at[0]) | static_cast<std::uint32_t>(at[1]) << 8 |
+               static_cast<std::uint32_t>(at[2]) << 16 | static_cast<std::uint32_t>(at[3]) << 24;
+    }
+
+    void validate() {
+        if (size_ < 12 || std::memcmp(data_, "SPLB", 4) != 0 || readU32(data_ + 4) != 1) {
+            throw std::runtime_error("Not a spell bank (bad header)");
+        }
+        count_ = readU32(data_ + 8);
+        if (count_ > (size_ - 12) / 8) {
+            throw std::runtime_error("Corrupt spell bank: directory out of range");
+        }
+        for (size_t i = 0; i < count_; ++i) {
+            const std::uint8_t* entry = data_ + 12 + 8 * i;
+            std::uint64_t offset = readU32(entry), length = readU32(entry + 4);
+            if (offset + length > size_) {
+                throw std::runtime_error("Corrupt spell bank: spell " + std::to_string(i) + " out of range");
+            }
+        }
+    }
+
+    void release() {
+#if SPELL_BANK_MMAP
+        if (data_) {
+            ::munmap(const_cast<std::uint8_t*>(data_), size_);
+        }
+#endif
+        data_ = nullptr;
+    }
+
+    const std::uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t count_ = 0;
+#if !SPELL_BANK_MMAP
+    std::vector<std::uint8_t> fallback_;
+#endif
+};
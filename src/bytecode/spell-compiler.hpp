@@ -0,0 +1,468 @@
+#pragma once
+
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "bytecode.hpp"
+#include "spell-bank.hpp"
+
+// Spell source language
+// ---------------------
+// A spell is a list of statements separated by `;`. `#` starts a comment.
+//
+//   health[0] = health[0] + 10;   # SET_HEALTH with a GET_HEALTH inside
+//   sound(123);                   # PLAY_SOUND
+//   (5 + 3) * 2                   # Any other expression is left on the stack
+//
+// statement := "health" "[" expr "]" "=" expr | "sound" "(" expr ")" | expr
+// expr      := term (("+" | "-") term)*
+// term      := unary (("*" | "/") unary)*
+// unary     := "-" unary | INTEGER | "health" "[" expr "]" | "(" expr ")"
+//
+// Code is generated exactly as a spell would be written by hand, so the
+// statement above compiles to the Spell 2 bytecode in bytecode.cpp. Run
+// optimizeSpell() on the result to fold constants and fuse superinstructions.
+
+// Bumped whenever the generated code changes, so cached output is discarded
+const std::uint32_t spellCompilerVersion = 1;
+
+// Thrown by compileSpellSource() on malformed source
+class SpellSyntaxError : public std::runtime_error {
+public:
+    SpellSyntaxError(size_t line, size_t column, const std::string& reason)
+        : std::runtime_error("Spell syntax error at " + std::to_string(line) + ":" + std::to_string(column) + ": " +
+                             reason),
+          line_(line), column_(column) {}
+
+    size_t line() const { return line_; }
+    size_t column() const { return column_; }
+
+private:
+    size_t line_;
+    size_t column_;
+};
+
+namespace spell_compiler {
+
+// Recursive descent parser that emits bytecode as it goes
+class Parser {
+public:
+    Parser(const char* begin, const char* end, std::vector<Bytecode>& out)
+        : at_(begin), end_(end), lineStart_(begin), out_(out) {}
+
+    void program() {
+        skipSpace();
+        while (at_ != end_) {
+            statement();
+            if (!accept(';') && at_ != end_) {
+                fail("expected ';'");
+            }
+            skipSpace();
+        }
+    }
+
+private:
+    void statement() {
+        if (acceptWord("health")) {
+            healthIndex();
+            if (accept('=')) {
+                expr();
+                emit(Instruction::SET_HEALTH);
+                return;
+            }
+            // A read of health[...] starting a larger expression
+            emit(Instruction::GET_HEALTH);
+            continueTerm();
+            continueExpr();
+        } else if (acceptWord("sound")) {
+            expect('(');
+            expr();
+            expect(')');
+            emit(Instruction::PLAY_SOUND);
+        } else {
+            expr();
+        }
+    }
+
+    void expr() {
+        term();
+        continueExpr();
+    }
+
+    void continueExpr() {
+        for (;;) {
+            if (accept('+')) {
+                term();
+                emit(Instruction::ADD);
+            } else if (accept('-')) {
+                term();
+                emit(Instruction::SUB);
+            } else {
+                return;
+            }
+        }
+    }
+
+    void term() {
+        unary();
+        continueTerm();
+    }
+
+    void continueTerm() {
+        for (;;) {
+            if (accept('*')) {
+                unary();
+                emit(Instruction::MUL);
+            } else if (accept('/')) {
+                unary();
+                emit(Instruction::DIV);
+            } else {
+                return;
+            }
+        }
+    }
+
+    void unary() {
+        skipSpace();
+        if (accept('-')) {
+            skipSpace();
+            if (at_ != end_ && std::isdigit(static_cast<unsigned char>(*at_))) {
+                emit(Instruction::LITERAL, integer(true));
+            } else {
+                emit(Instruction::LITERAL, 0); // -x is 0 - x
+                unary();
+                emit(Instruction::SUB);
+            }
+        } else if (at_ != end_ && std::isdigit(static_cast<unsigned char>(*at_))) {
+            emit(Instruction::LITERAL, integer(false));
+        } else if (acceptWord("health")) {
+            healthIndex();
+            emit(Instruction::GET_HEALTH);
+        } else if (accept('(')) {
+            expr();
+            expect(')');
+        } else {
+            fail(at_ == end_ ? "unexpected end of spell" : "expected an expression");
+        }
+    }
+
+    // Parses `[expr]`, leaving the wizard ID on the stack
+    void healthIndex() {
+        expect('[');
+        expr();
+        expect(']');
+    }
+
+    int integer(bool negative) {
+        long long value = 0;
+        while (at_ != end_ && std::isdigit(static_cast<unsigned char>(*at_))) {
+            value = value * 10 + (*at_++ - '0');
+            if (value > static_cast<long long>(INT_MAX) + 1) {
+                fail("integer out of range");
+            }
+        }
+        if (negative) {
+            value = -value;
+        } else if (value > INT_MAX) {
+            fail("integer out of range");
+        }
+        return static_cast<int>(value);
+    }
+
+    void emit(Instruction instruction, int argument = 0) {
+        out_.push_back({instruction, argument});
+    }
+
+    void skipSpace() {
+        while (at_ != end_) {
+            if (*at_ == '#') {
+                while (at_ != end_ && *at_ != '\n') ++at_;
+            } else if (*at_ == '\n') {
+                ++at_;
+                ++line_;
+                lineStart_ = at_;
+            } else if (std::isspace(static_cast<unsigned char>(*at_))) {
+                ++at_;
+            } else {
+                return;
+            }
+        }
+    }
+
+    bool accept(char c) {
+        skipSpace();
+        if (at_ != end_ && *at_ == c) {
+            ++at_;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!accept(c)) {
+            fail(std::string("expected '") + c + "'");
+        }
+    }
+
+    bool acceptWord(const char* word) {
+        skipSpace();
+        size_t length = std::strlen(word);
+        if (static_cast<size_t>(end_ - at_) < length || std::strncmp(at_, word, length) != 0) {
+            return false;
+        }
+        const char* after = at_ + length;
+        if (after != end_ && (std::isalnum(static_cast<unsigned char>(*after)) || *after == '_')) {
+            return false; // Only a prefix of a longer identifier
+        }
+        at_ = after;
+        return true;
+    }
+
+    [[noreturn]] void fail(const std::string& reason) {
+        throw SpellSyntaxError(line_, static_cast<size_t>(at_ - lineStart_) + 1, reason);
+    }
+
+    const char* at_;
+    const char* end_;
+    const char* lineStart_;
+    size_t line_ = 1;
+    std::vector<Bytecode>& out_;
+};
+
+} // namespace spell_compiler
+
+// Compiles spell source to bytecode. Throws SpellSyntaxError on bad input.
+inline std::vector<Bytecode> compileSpellSource(const std::string& source) {
+    std::vector<Bytecode> bytecode;
+    spell_compiler::Parser(source.data(), source.data() + source.size(), bytecode).program();
+    return bytecode;
+}
+
+// FNV-1a over the source text, salted with the compiler version
+inline std::uint64_t hashSpellSource(const std::string& source) {
+    std::uint64_t hash = 14695981039346656037ull ^ spellCompilerVersion;
+    for (char c : source) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Marks an empty slot in SpellCache's table
+const std::uint32_t noCachedSpell = UINT32_MAX;
+
+// Compiled spells keyed by their source. compile() only runs the compiler for
+// source it has not seen before. The cache can be saved to a file and loaded
+// at the next startup, so spells that did not change are never compiled again.
+//
+// Cache file (little-endian):
+//   magic "SPLC", format version (u32), spellCompilerVersion (u32), count (u32)
+//   count x { source hash (u64), source length (u32), source,
+//             code length (u32), code in the spell bank encoding }
+// A file written by another compiler version, or a truncated or corrupt one,
+// is ignored and its spells are compiled again.
+//
+// Entries are found through an open-addressing table of indices and compared
+// by hash, then by source. Loaded sources stay in the file buffer they were
+// read into, so loading allocates once per spell, for its bytecode.
+class SpellCache {
+public:
+    SpellCache() = default;
+
+    // Loads `path` if it exists and is a valid cache for this compiler version
+    explicit SpellCache(const std::string& path) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) {
+            return;
+        }
+        loaded_.resize(static_cast<size_t>(in.tellg()));
+        in.seekg(0);
+        if (!in.read(loaded_.data(), static_cast<std::streamsize>(loaded_.size())) || !load()) {
+            entries_.clear();
+            slots_.clear();
+            loaded_.clear();
+        }
+    }
+
+    // Entries point into loaded_ and ownedSources_, which a copy would not share
+    SpellCache(const SpellCache&) = delete;
+    SpellCache& operator=(const SpellCache&) = delete;
+
+    // Returns the bytecode for `source`, compiling it on a miss. The reference
+    // stays valid for the lifetime of the cache.
+    const std::vector<Bytecode>& compile(const std::string& source) {
+        std::uint64_t hash = hashSpellSource(source);
+        if (!slots_.empty()) {
+            size_t mask = slots_.size() - 1;
+            for (size_t slot = firstSlotFor(hash); slots_[slot] != noCachedSpell; slot = (slot + 1) & mask) {
+                Entry& entry = entries_[slots_[slot]];
+                if (entry.hash == hash && entry.length == source.size() &&
+                    std::memcmp(entry.source, source.data(), source.size()) == 0) {
+                    ++hits_;
+                    return entry.code;
+                }
+            }
+        }
+        ++misses_;
+        std::vector<Bytecode> code = compileSpellSource(source);
+        ownedSources_.push_back(source);
+        insert(hash, ownedSources_.back().data(), source.size(), std::move(code));
+        return entries_.back().code;
+    }
+
+    size_t size() const { return entries_.size(); }
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+
+    // Writes a temporary file next to `path` and renames it over `path`, so
+    // a crash while saving never leaves a truncated cache behind
+    void save(const std::string& path) const {
+        std::vector<std::uint8_t> file;
+        file.insert(file.end(), {'S', 'P', 'L', 'C'});
+        putU32(file, formatVersion);
+        putU32(file, spellCompilerVersion);
+        putU32(file, static_cast<std::uint32_t>(entries_.size()));
+        for (const Entry& entry : entries_) {
+            putU32(file, static_cast<std::uint32_t>(entry.hash));
+            putU32(file, static_cast<std::uint32_t>(entry.hash >> 32));
+            putU32(file, static_cast<std::uint32_t>(entry.length));
+            file.insert(file.end(), entry.source, entry.source + entry.length);
+            size_t lengthAt = file.size();
+            putU32(file, 0);
+            encodeSpell(entry.code, file);
+            std::uint32_t length = static_cast<std::uint32_t>(file.size() - lengthAt - 4);
+            for (int i = 0; i < 4; ++i) file[lengthAt + i] = static_cast<std::uint8_t>(length >> (8 * i));
+        }
+
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+            out.close();
+            if (!out) {
+                std::remove(temporary.c_str());
+                throw std::runtime_error("Could not write spell cache: " + temporary);
+            }
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("Could not replace spell cache: " + path);
+        }
+    }
+
+private:
+    struct Entry {
+        std::uint64_t hash;
+        const char* source; // In loaded_ or ownedSources_
+        size_t length;
+        std::vector<Bytecode> code;
+    };
+
+    static const std::uint32_t formatVersion = 2;
+
+    static void putU32(std::vector<std::uint8_t>& out, std::uint32_t value) {
+        for (int i = 0; i < 4; ++i) out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+
+    static std::uint32_t getU32(const std::uint8_t* at) {
+        return static_cast<std::uint32_t>(at[0]) | static_cast<std::uint32_t>(at[1]) << 8 |
+               static_cast<std::uint32_t>(at[2]) << 16 | static_cast<std::uint32_t>(at[3]) << 24;
+    }
+
+    size_t firstSlotFor(std::uint64_t hash) const {
+        return static_cast<size_t>((hash * 11400714819323198485ull) >> 32) & (slots_.size() - 1);
+    }
+
+    // Keeps the table at most half full
+    void reserveSlots(size_t entries) {
+        if (2 * entries <= slots_.size()) {
+            return;
+        }
+        size_t size = 16;
+        while (size < 2 * entries) {
+            size *= 2;
+        }
+        slots_.assign(size, noCachedSpell);
+        for (size_t index = 0; index < entries_.size(); ++index) {
+            place(index);
+        }
+    }
+
+    void place(size_t index) {
+        size_t slot = firstSlotFor(entries_[index].hash);
+        while (slots_[slot] != noCachedSpell) {
+            slot = (slot + 1) & (slots_.size() - 1);
+        }
+        slots_[slot] = static_cast<std::uint32_t>(index);
+    }
+
+    void insert(std::uint64_t hash, const char* source, size_t length, std::vector<Bytecode> code) {
+        reserveSlots(entries_.size() + 1);
+        entries_.push_back(Entry{hash, source, length, std::move(code)});
+        place(entries_.size() - 1);
+    }
+
+    // Parses loaded_. Returns false if it is truncated or corrupt; a file that
+    // is not a cache or is for another compiler version loads as empty.
+    bool load() {
+        const std::uint8_t* at = reinterpret_cast<const std::uint8_t*>(loaded_.data());
+        const std::uint8_t* end = at + loaded_.size();
+        if (loaded_.size() < 16 || std::memcmp(at, "SPLC", 4) != 0 || getU32(at + 4) != formatVersion ||
+            getU32(at + 8) != spellCompilerVersion) {
+            loaded_.clear();
+            return true; // Not ours or stale: start empty and recompile
+        }
+        std::uint32_t count = getU32(at + 12);
+        at += 16;
+        const size_t minimumEntrySize = 16; // Hash and both lengths
+        if (count > static_cast<size_t>(end - at) / minimumEntrySize) {
+            return false;
+        }
+        reserveSlots(count);
+        std::vector<Bytecode> decoded;
+        try {
+            for (std::uint32_t i = 0; i < count; ++i) {
+                if (end - at < 12) {
+                    return false;
+                }
+                std::uint64_t hash = getU32(at) | static_cast<std::uint64_t>(getU32(at + 4)) << 32;
+                std::uint32_t sourceLength = getU32(at + 8);
+                at += 12;
+                if (static_cast<size_t>(end - at) < sourceLength + size_t(4)) {
+                    return false;
+                }
+                const char* source = reinterpret_cast<const char*>(at);
+                at += sourceLength;
+                std::uint32_t length = getU32(at);
+                at += 4;
+                if (static_cast<size_t>(end - at) < length) {
+                    return false;
+                }
+                // Decoded into a scratch buffer first, so each spell's
+                // bytecode is allocated once at its exact size
+                decoded.clear();
+                for (const std::uint8_t* codeEnd = at + length; at != codeEnd;) {
+                    decoded.push_back(decodeInstruction(at, codeEnd));
+                }
+                insert(hash, source, sourceLength, std::vector<Bytecode>(decoded.begin(), decoded.end()));
+            }
+        } catch (const std::runtime_error&) {
+            return false; // decodeInstruction() found a bad opcode or argument
+        }
+        return at == end;
+    }
+
+    std::deque<Entry> entries_;       // A deque, so references to code stay valid
+    std::vector<std::uint32_t> slots_; // Indices into entries_, or noCachedSpell
+    std::vector<char> loaded_;          // The cache file, holding loaded sources
+    std::deque<std::string> ownedSources_; // Sources compiled since loading
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+};
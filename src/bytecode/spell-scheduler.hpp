@@ -0,0 +1,244 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "bytecode.hpp"
+
+// One game-visible effect of a spell, recorded instead of applied
+struct SpellEffect {
+    enum Kind { SET_HEALTH, PLAY_SOUND };
+    Kind kind;
+    int id;     // Wizard ID or sound ID
+    int value;  // New health, unused for sounds
+};
+
+// What one SpellScheduler::runTick() did
+struct TickReport {
+    size_t spellsRun = 0;
+    size_t spellsFailed = 0; // Threw (stack underflow, division by zero, ...); their effects are dropped
+    size_t healthWrites = 0;
+};
+
+// Runs a tick's worth of queued spells on a pool of worker threads, each with
+// its own VM.
+//
+// Every spell in a tick sees the health table as it was when the tick started,
+// plus its own writes. Writes are not applied directly: each VM is bound to a
+// SpellHost that appends them to an effect log. Invocations are handed out in
+// fixed-size chunks and every chunk has its own log, so at the end of the tick
+// the logs are applied in queue order and the result never depends on the
+// number of threads or on scheduling. If two spells write the same wizard, the
+// one queued last wins.
+class SpellScheduler {
+public:
+    static const size_t chunkSize = 64; // Invocations claimed by a worker at a time
+
+    explicit SpellScheduler(size_t threads = std::thread::hardware_concurrency()) {
+        threads = std::max<size_t>(threads, 1);
+        for (size_t i = 0; i < threads; ++i) {
+            workers_.emplace_back(new Worker(this));
+        }
+        // The thread calling runTick() acts as worker 0
+        for (size_t i = 1; i < threads; ++i) {
+            pool_.emplace_back([this, i] { workerLoop(*workers_[i]); });
+        }
+    }
+
+    ~SpellScheduler() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread& thread : pool_) {
+            thread.join();
+        }
+    }
+
+    SpellScheduler(const SpellScheduler&) = delete;
+    SpellScheduler& operator=(const SpellScheduler&) = delete;
+
+    size_t threads() const { return workers_.size(); }
+
+    // Queues a spell for the next tick. The spell is not copied and must stay
+    // alive until runTick() returns.
+    void enqueue(const std::vector<Bytecode>& spell) {
+        queue_.push_back(&spell);
+    }
+
+    size_t queued() const { return queue_.size(); }
+
+    // Runs every queued spell against `healths`, then applies their effects in
+    // queue order and empties the queue
+    TickReport runTick(std::vector<int>& healths) {
+        snapshot_ = &healths;
+        size_t chunks = (queue_.size() + chunkSize - 1) / chunkSize;
+        if (logs_.size() < chunks) {
+            logs_.resize(chunks);
+        }
+        nextChunk_.store(0, std::memory_order_relaxed);
+        for (std::unique_ptr<Worker>& worker : workers_) {
+            worker->failed = 0;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            busy_ = pool_.size();
+            ++generation_;
+        }
+        wake_.notify_all();
+        work(*workers_[0]);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_.wait(lock, [this] { return busy_ == 0; });
+        }
+
+        // An unexpected exception fails the whole tick before anything is
+        // applied, so `healths` is left as it was
+        sounds_.clear();
+        if (error_) {
+            std::exception_ptr error = error_;
+            error_ = nullptr;
+            queue_.clear();
+            std::rethrow_exception(error);
+        }
+
+        // Merge: chunk order is queue order
+        TickReport report;
+        report.spellsRun = queue_.size();
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            for (const SpellEffect& effect : logs_[chunk]) {
+                if (effect.kind == SpellEffect::SET_HEALTH) {
+                    healths[effect.id] = effect.value;
+                    ++report.healthWrites;
+                } else {
+                    sounds_.push_back(effect.id);
+                }
+            }
+        }
+        for (std::unique_ptr<Worker>& worker : workers_) {
+            report.spellsFailed += worker->failed;
+        }
+        queue_.clear();
+        return report;
+    }
+
+    // Sounds played during the last tick, in queue order
+    const std::vector<int>& soundsPlayed() const { return sounds_; }
+
+private:
+    // Per-thread state. `vm` is bound to a host that reads the tick snapshot
+    // and records into `log`.
+    struct Worker {
+        explicit Worker(SpellScheduler* owner)
+            : owner(owner), vm(host()) {}
+
+        SpellHost host() {
+            SpellHost host;
+            host.user = this;
+            host.getHealth = [](void* user, int wizardId, int& health) {
+                Worker* worker = static_cast<Worker*>(user);
+                const std::vector<int>& snapshot = *worker->owner->snapshot_;
+                if (wizardId < 0 || wizardId >= static_cast<int>(snapshot.size())) return false;
+                // The spell's own writes take precedence over the snapshot
+                for (size_t i = worker->log->size(); i-- > worker->spellStart;) {
+                    const SpellEffect& effect = (*worker->log)[i];
+                    if (effect.kind == SpellEffect::SET_HEALTH && effect.id == wizardId) {
+                        health = effect.value;
+                        return true;
+                    }
+                }
+                health = snapshot[wizardId];
+                return true;
+            };
+            host.setHealth = [](void* user, int wizardId, int health) {
+                Worker* worker = static_cast<Worker*>(user);
+                if (wizardId < 0 || wizardId >= static_cast<int>(worker->owner->snapshot_->size())) return false;
+                worker->log->push_back({SpellEffect::SET_HEALTH, wizardId, health});
+                return true;
+            };
+            host.playSound = [](void* user, int soundId) {
+                Worker* worker = static_cast<Worker*>(user);
+                worker->log->push_back({SpellEffect::PLAY_SOUND, soundId, 0});
+            };
+            return host;
+        }
+
+        SpellScheduler* owner;
+        VM vm;
+        std::vector<SpellEffect>* log = nullptr; // Log of the chunk being run
+        size_t spellStart = 0;                   // Where the current spell's effects begin in `log`
+        size_t failed = 0;
+    };
+
+    void workerLoop(Worker& worker) {
+        unsigned long seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+                if (stopping_) {
+                    return;
+                }
+                seen = generation_;
+            }
+            work(worker);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --busy_;
+            }
+            done_.notify_one();
+        }
+    }
+
+    // Claims chunks until the queue is exhausted
+    void work(Worker& worker) {
+        const size_t count = queue_.size();
+        for (;;) {
+            size_t chunk = nextChunk_.fetch_add(1, std::memory_order_relaxed);
+            size_t begin = chunk * chunkSize;
+            if (begin >= count) {
+                return;
+            }
+            size_t end = std::min(begin + chunkSize, count);
+            worker.log = &logs_[chunk];
+            worker.log->clear(); // Keeps its capacity from earlier ticks
+            for (size_t i = begin; i < end; ++i) {
+                worker.spellStart = worker.log->size();
+                try {
+                    worker.vm.interpret(*queue_[i]);
+                } catch (const std::runtime_error&) {
+                    worker.log->resize(worker.spellStart); // A failed spell has no effects
+                    ++worker.failed;
+                } catch (...) {
+                    worker.log->resize(worker.spellStart);
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (!error_) error_ = std::current_exception();
+                }
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> pool_;
+
+    std::vector<const std::vector<Bytecode>*> queue_;
+    std::vector<std::vector<SpellEffect>> logs_; // One per chunk, reused across ticks
+    std::vector<int> sounds_;
+    const std::vector<int>* snapshot_ = nullptr;
+    std::atomic<size_t> nextChunk_{0};
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    unsigned long generation_ = 0;
+    size_t busy_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+};
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include "bytecode.hpp"
+
+// Computed goto ("labels as values") is a GCC/Clang extension. Other compilers
+// fall back to a switch over the same pre-decoded stream.
+#if defined(__GNUC__) || defined(__clang__)
+#define THREADED_VM_COMPUTED_GOTO 1
+#else
+#define THREADED_VM_COMPUTED_GOTO 0
+#endif
+
+// One pre-decoded instruction. With computed goto, `handler` is the address of
+// the label that executes it, so dispatch is a single indirect jump.
+struct ThreadedOp {
+    const void* handler;
+    std::uint8_t opcode; // Instruction value, or ThreadedVM::HALT_OPCODE
+    int argument;
+};
+
+// A spell decoded once and run many times by ThreadedVM.
+struct ThreadedSpell {
+    std::vector<ThreadedOp> code; // Always ends with a HALT op
+    size_t maxStackDepth = 0;
+};
+
+// Second execution engine for spells: direct-threaded dispatch over a
+// pre-decoded stream and a fixed-size operand stack without per-op checks.
+// Stack bounds are proven once in decode(), so the hot loop only touches memory.
+// Like the other fast paths it indexes its own wizard table instead of going
+// through a SpellHost; invalid wizard IDs are reported to the trace sink.
+class ThreadedVM {
+public:
+    static const std::uint8_t HALT_OPCODE = static_cast<std::uint8_t>(Instruction::PLAY_SOUND_IMM) + 1;
+    static const size_t maxStackSize_ = VM::maxStackSize();
+
+    // Same starting state as VM: two wizards and no I/O unless a sink is given
+    explicit ThreadedVM(const SpellTraceSink& trace = SpellTraceSink{nullptr, nullptr})
+        : wizardHealths_{100, 80}, trace_(trace) {}
+
+    // Decodes a spell for this engine. Spells that would overflow or underflow
+    // the stack are rejected here instead of failing halfway through execution.
+    static ThreadedSpell decode(const std::vector<Bytecode>& bytecode) {
+        const void* const* table = execute(nullptr, nullptr);
+        ThreadedSpell spell;
+        spell.code.reserve(bytecode.size() + 1);
+
+        size_t depth = 0;
+        for (const Bytecode& instruction : bytecode) {
+            std::uint8_t opcode = static_cast<std::uint8_t>(instruction.instruction);
+            if (opcode >= HALT_OPCODE) {
+                throw std::runtime_error("Unknown instruction.");
+            }
+            size_t pops = stackPops(instruction.instruction);
+            if (depth < pops) {
+                throw std::runtime_error("Stack underflow!");
+            }
+            depth -= pops;
+            depth += stackPushes(instruction.instruction);
+            if (depth > maxStackSize_) {
+                throw std::runtime_error("Stack overflow!");
+            }
+            if (depth > spell.maxStackDepth) {
+                spell.maxStackDepth = depth;
+            }
+            spell.code.push_back({table ? table[opcode] : nullptr, opcode, instruction.argument});
+        }
+        spell.code.push_back({table ? table[HALT_OPCODE] : nullptr, HALT_OPCODE, 0});
+        return spell;
+    }
+
+    // Runs a decoded spell. Produces the same health and stack state and the
+    // same trace events as VM::interpret on a VM bound to its own table.
+    void run(const ThreadedSpell& spell) {
+        stackSize_ = 0;
+        execute(this, spell.code.data());
+        trace(TraceEvent::SPELL_FINISHED, 0);
+    }
+
+    void printWizardHealth() const {
+        for (size_t i = 0; i < wizardHealths_.size(); ++i) {
+            std::cout << "Wizard " << i << " Health: " << wizardHealths_[i] << std::endl;
+        }
+    }
+
+    const std::vector<int>& getWizardHealths() const {
+        return wizardHealths_;
+    }
+
+    std::vector<int> getStack() const {
+        return std::vector<int>(stack_.begin(), stack_.begin() + stackSize_);
+    }
+
+private:
+    // The interpreter proper. Called with vm == nullptr it only hands out the
+    // label table so decode() can bind handlers.
+    static const void* const* execute(ThreadedVM* vm, const ThreadedOp* ip) {
+#if THREADED_VM_COMPUTED_GOTO
+        static const void* const table[] = {
+            &&op_LITERAL, &&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV,
+            &&op_SET_HEALTH, &&op_GET_HEALTH, &&op_PLAY_SOUND,
+            &&op_GET_HEALTH_IMM, &&op_SET_HEALTH_IMM, &&op_ADD_IMM, &&op_SUB_IMM,
+            &&op_MUL_IMM, &&op_DIV_IMM, &&op_PLAY_SOUND_IMM, &&op_HALT
+        };
+        if (vm == nullptr) {
+            return table;
+        }
+#define VM_CASE(name) op_##name:
+#define VM_NEXT() do { op = ip++; goto *op->handler; } while (0)
+#else
+        if (vm == nullptr) {
+            return nullptr;
+        }
+#define VM_CASE(name) case static_cast<std::uint8_t>(Instruction::name):
+#define VM_NEXT() continue
+#endif
+        int* const stackBase = vm->stack_.data();
+        int* const healths = vm->wizardHealths_.data();
+        const int wizardCount = static_cast<int>(vm->wizardHealths_.size());
+        int* sp = stackBase; // Points one past the top of the stack
+        const ThreadedOp* op;
+
+#if THREADED_VM_COMPUTED_GOTO
+        VM_NEXT();
+#else
+        for (;;) {
+            op = ip++;
+            switch (op->opcode) {
+#endif
+        VM_CASE(LITERAL)
+            *sp++ = op->argument;
+            VM_NEXT();
+        VM_CASE(ADD)
+            --sp;
+            sp[-1] += sp[0];
+            VM_NEXT();
+        VM_CASE(SUB)
+            --sp;
+            sp[-1] -= sp[0];
+            VM_NEXT();
+        VM_CASE(MUL)
+            --sp;
+            sp[-1] *= sp[0];
+            VM_NEXT();
+        VM_CASE(DIV)
+            --sp;
+            if (sp[0] == 0) {
+                throw std::runtime_error("Division by zero!");
+            }
+            sp[-1] /= sp[0];
+            VM_NEXT();
+        VM_CASE(SET_HEALTH) {
+            sp -= 2;
+            int wizardId = sp[0];
+            if (wizardId >= 0 && wizardId < wizardCount) {
+                healths[wizardId] = sp[1];
+            } else {
+                vm->trace(TraceEvent::INVALID_WIZARD_ID, wizardId);
+            }
+            VM_NEXT();
+        }
+        VM_CASE(GET_HEALTH) {
+            int wizardId = sp[-1];
+            if (wizardId >= 0 && wizardId < wizardCount) {
+                sp[-1] = healths[wizardId];
+                VM_NEXT();
+            }
+            // Cold path: VM::interpret pushes nothing here, so the stack depth no
+            // longer matches what decode() proved. Finish the spell checked.
+            vm->trace(TraceEvent::INVALID_WIZARD_ID, wizardId);
+            --sp;
+            vm->stackSize_ = static_cast<size_t>(sp - stackBase);
+            vm->resumeChecked(ip);
+            return nullptr;
+        }
+        VM_CASE(PLAY_SOUND)
+            --sp;
+            VM_NEXT();
+        VM_CASE(GET_HEALTH_IMM) {
+            int wizardId = op->argument;
+            if (wizardId >= 0 && wizardId < wizardCount) {
+                *sp++ = healths[wizardId];
+                VM_NEXT();
+            }
+            // Cold path: nothing is pushed, same as GET_HEALTH above
+            vm->trace(TraceEvent::INVALID_WIZARD_ID, wizardId);
+            vm->stackSize_ = static_cast<size_t>(sp - stackBase);
+            vm->resumeChecked(ip);
+            return nullptr;
+        }
+        VM_CASE(SET_HEALTH_IMM) {
+            --sp;
+            int wizardId = op->argument;
+            if (wizardId >= 0 && wizardId < wizardCount) {
+                healths[wizardId] = sp[0];
+            } else {
+                vm->trace(TraceEvent::INVALID_WIZARD_ID, wizardId);
+            }
+            VM_NEXT();
+        }
+        VM_CASE(ADD_IMM)
+            sp[-1] += op->argument;
+            VM_NEXT();
+        VM_CASE(SUB_IMM)
+            sp[-1] -= op->argument;
+            VM_NEXT();
+        VM_CASE(MUL_IMM)
+            sp[-1] *= op->argument;
+            VM_NEXT();
+        VM_CASE(DIV_IMM)
+            if (op->argument == 0) {
+                throw std::runtime_error("Division by zero!");
+            }
+            sp[-1] /= op->argument;
+            VM_NEXT();
+        VM_CASE(PLAY_SOUND_IMM)
+            VM_NEXT();
+#if THREADED_VM_COMPUTED_GOTO
+        op_HALT:
+#else
+            default:
+#endif
+            vm->stackSize_ = static_cast<size_t>(sp - stackBase);
+            return nullptr;
+#if !THREADED_VM_COMPUTED_GOTO
+            }
+        }
+#endif
+#undef VM_CASE
+#undef VM_NEXT
+    }
+
+    // Bounds-checked continuation with VM::interpret semantics, used only after
+    // an invalid GET_HEALTH(_IMM) invalidates the depths proven at decode time.
+    void resumeChecked(const ThreadedOp* ip) {
+        for (; ip->opcode != HALT_OPCODE; ++ip) {
+            Instruction instruction = static_cast<Instruction>(ip->opcode);
+            if (stackSize_ < stackPops(instruction)) {
+                throw std::runtime_error("Stack underflow!");
+            }
+            switch (instruction) {
+                case Instruction::LITERAL:
+                    if (stackSize_ >= maxStackSize_) {
+                        throw std::runtime_error("Stack overflow!");
+                    }
+                    stack_[stackSize_++] = ip->argument;
+                    break;
+                case Instruction::ADD:
+                case Instruction::SUB:
+                case Instruction::MUL:
+                case Instruction::DIV: {
+                    int operand2 = stack_[--stackSize_];
+                    int& operand1 = stack_[stackSize_ - 1];
+                    if (instruction == Instruction::ADD) operand1 += operand2;
+                    else if (instruction == Instruction::SUB) operand1 -= operand2;
+                    else if (instruction == Instruction::MUL) operand1 *= operand2;
+                    else if (operand2 == 0) throw std::runtime_error("Division by zero!");
+                    else operand1 /= operand2;
+                    break;
+                }
+                case Instruction::SET_HEALTH: {
+                    int health = stack_[--stackSize_];
+                    int wizardId = stack_[--stackSize_];
+                    if (wizardId >= 0 && wizardId < static_cast<int>(wizardHealths_.size())) {
+                        wizardHealths_[wizardId] = health;
+                    } else {
+                        trace(TraceEvent::INVALID_WIZARD_ID, wizardId);
+                    }
+                    break;
+                }
+                case Instruction::GET_HEALTH: {
+                    int wizardId = stack_[--stackSize_];
+                    if (wizardId >= 0 && wizardId < static_cast<int>(wizardHealths_.size())) {
+                        stack_[stackSize_++] = wizardHealths_[wizardId];
+                    } else {
+                        trace(TraceEvent::INVALID_WIZARD_ID, wizardId);
+                    }
+                    break;
+                }
+                case Instruction::PLAY_SOUND:
+                    --stackSize_;
+                    break;
+                case Instruction::GET_HEALTH_IMM:
+                case Instruction::SET_HEALTH_IMM: {
+                    int wizardId = ip->argument;
+                    if (wizardId < 0 || wizardId >= static_cast<int>(wizardHealths_.size())) {
+                        if (instruction == Instruction::SET_HEALTH_IMM) --stackSize_;
+                        trace(TraceEvent::INVALID_WIZARD_ID, wizardId);
+                    } else if (instruction == Instruction::SET_HEALTH_IMM) {
+                        wizardHealths_[wizardId] = stack_[--stackSize_];
+                    } else if (stackSize_ >= maxStackSize_) {
+                        throw std::runtime_error("Stack overflow!");
+                    } else {
+                        stack_[stackSize_++] = wizardHealths_[wizardId];
+                    }
+                    break;
+                }
+                case Instruction::ADD_IMM: stack_[stackSize_ - 1] += ip->argument; break;
+                case Instruction::SUB_IMM: stack_[stackSize_ - 1] -= ip->argument; break;
+                case Instruction::MUL_IMM: stack_[stackSize_ - 1] *= ip->argument; break;
+                case Instruction::DIV_IMM:
+                    if (ip->argument == 0) {
+                        throw std::runtime_error("Division by zero!");
+                    }
+                    stack_[stackSize_ - 1] /= ip->argument;
+                    break;
+                case Instruction::PLAY_SOUND_IMM:
+                    break;
+            }
+        }
+    }
+
+    void trace(TraceEvent event, int value) {
+        if (trace_.trace) {
+            trace_.trace(trace_.user, event, value);
+        }
+    }
+
+    std::array<int, maxStackSize_> stack_; // Fixed-size operand stack
+    size_t stackSize_ = 0;
+    std::vector<int> wizardHealths_; // Simulate game state (wizard health)
+    SpellTraceSink trace_;
+};
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <climits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "bytecode.hpp"
+
+// Thrown by verifySpell() when a spell cannot be proven safe
+class VerificationError : public std::runtime_error {
+public:
+    VerificationError(size_t index, Instruction instruction, const std::string& reason)
+        : std::runtime_error("Spell rejected at instruction " + std::to_string(index) + " (" +
+                             instructionToString(instruction) + "): " + reason),
+          index_(index) {}
+
+    size_t index() const { return index_; }
+
+private:
+    size_t index_;
+};
+
+// A spell that passed verifySpell(). It can only be created by the verifier,
+// so holding one is proof that VM::runVerified() may skip every runtime check.
+class VerifiedSpell {
+public:
+    const std::vector<Bytecode>& code() const { return code_; }
+    size_t maxStackDepth() const { return maxStackDepth_; }
+    size_t finalStackDepth() const { return finalStackDepth_; }
+    size_t wizardCount() const { return wizardCount_; }
+
+private:
+    friend VerifiedSpell verifySpell(const std::vector<Bytecode>& bytecode, size_t wizardCount);
+    VerifiedSpell() = default;
+
+    std::vector<Bytecode> code_;
+    size_t maxStackDepth_ = 0;
+    size_t finalStackDepth_ = 0;
+    size_t wizardCount_ = 0;
+};
+
+// Runs once per spell at load time. Bytecode has no jumps, so one linear pass
+// sees every path: it tracks the stack depth and, where possible, the constant
+// value of each stack slot. A spell is accepted only if it never underflows or
+// overflows, every wizard ID is a constant in [0, wizardCount), and every
+// divisor is a non-zero constant. Dividing by -1 is accepted only when the
+// dividend is a known constant other than INT_MIN, since INT_MIN / -1
+// overflows.
+inline VerifiedSpell verifySpell(const std::vector<Bytecode>& bytecode, size_t wizardCount) {
+    // What the verifier knows about one stack slot
+    struct Slot {
+        bool known;
+        int value;
+    };
+
+    VerifiedSpell spell;
+    std::vector<Slot> stack;
+    stack.reserve(VM::maxStackSize());
+
+    for (size_t i = 0; i < bytecode.size(); ++i) {
+        const Bytecode& instruction = bytecode[i];
+        auto pop = [&]() {
+            if (stack.empty()) {
+                throw VerificationError(i, instruction.instruction, "stack underflow");
+            }
+            Slot slot = stack.back();
+            stack.pop_back();
+            return slot;
+        };
+        auto checkDivision = [&](Slot dividend, int divisor) {
+            if (divisor == -1 && !(dividend.known && dividend.value != INT_MIN)) {
+                throw VerificationError(i, instruction.instruction, "dividing by -1 may overflow");
+            }
+        };
+        auto checkWizardId = [&](Slot id) {
+            if (!id.known) {
+                throw VerificationError(i, instruction.instruction, "wizard ID is not a constant");
+            }
+            if (id.value < 0 || static_cast<size_t>(id.value) >= wizardCount) {
+                throw VerificationError(i, instruction.instruction,
+                                        "invalid wizard ID " + std::to_string(id.value));
+            }
+        };
+
+        switch (instruction.instruction) {
+            case Instruction::LITERAL:
+                stack.push_back({true, instruction.argument});
+                break;
+            case Instruction::ADD:
+            case Instruction::SUB:
+            case Instruction::MUL:
+            case Instruction::DIV: {
+                Slot operand2 = pop();
+                Slot operand1 = pop();
+                if (instruction.instruction == Instruction::DIV && !(operand2.known && operand2.value != 0)) {
+                    throw VerificationError(i, instruction.instruction, "divisor is not a non-zero constant");
+                }
+                if (instruction.instruction == Instruction::DIV) {
+                    checkDivision(operand1, operand2.value);
+                }
+                // Overflowing results are left unknown rather than guessed
+                Slot result = {false, 0};
+                result.known = operand1.known && operand2.known &&
+                               evaluateArithmetic(instruction.instruction, operand1.value, operand2.value, result.value);
+                stack.push_back(result);
+                break;
+            }
+            case Instruction::ADD_IMM:
+            case Instruction::SUB_IMM:
+            case Instruction::MUL_IMM:
+            case Instruction::DIV_IMM: {
+                Slot operand1 = pop();
+                if (instruction.instruction == Instruction::DIV_IMM && instruction.argument == 0) {
+                    throw VerificationError(i, instruction.instruction, "division by zero");
+                }
+                if (instruction.instruction == Instruction::DIV_IMM) {
+                    checkDivision(operand1, instruction.argument);
+                }
+                Slot result = {false, 0};
+                result.known = operand1.known &&
+                               evaluateArithmetic(instruction.instruction, operand1.value, instruction.argument, result.value);
+                stack.push_back(result);
+                break;
+            }
+            case Instruction::SET_HEALTH:
+                pop(); // Health amount may be anything
+                checkWizardId(pop());
+                break;
+            case Instruction::GET_HEALTH:
+                checkWizardId(pop());
+                stack.push_back({false, 0});
+                break;
+            case Instruction::SET_HEALTH_IMM:
+                pop();
+                checkWizardId({true, instruction.argument});
+                break;
+            case Instruction::GET_HEALTH_IMM:
+                checkWizardId({true, instruction.argument});
+                stack.push_back({false, 0});
+                break;
+            case Instruction::PLAY_SOUND:
+                pop();
+                break;
+            case Instruction::PLAY_SOUND_IMM:
+                break;
+            default:
+                throw VerificationError(i, instruction.instruction, "unknown instruction");
+        }
+
+        if (stack.size() > VM::maxStackSize()) {
+            throw VerificationError(i, instruction.instruction, "stack overflow");
+        }
+        if (stack.size() > spell.maxStackDepth_) {
+            spell.maxStackDepth_ = stack.size();
+        }
+    }
+
+    spell.code_ = bytecode;
+    spell.finalStackDepth_ = stack.size();
+    spell.wizardCount_ = wizardCount;
+    return spell;
+}
+
+inline void VM::runVerified(const VerifiedSpell& spell) {
+    requireOwnTable();
+    // The only check left is a per-spell one: the spell was proven against a
+    // number of wizards this VM must have.
+    if (spell.wizardCount() > wizardHealths_.size()) {
+        throw std::runtime_error("Spell was verified for more wizards than this VM has!");
+    }
+
+    stack_.resize(spell.maxStackDepth()); // Only allocates the first time a depth is seen
+    int* sp = stack_.data();
+    int* const healths = wizardHealths_.data();
+
+    for (const Bytecode& instruction : spell.code()) {
+        switch (instruction.instruction) {
+            case Instruction::LITERAL:
+                *sp++ = instruction.argument;
+                break;
+            case Instruction::ADD:
+                --sp;
+                sp[-1] += sp[0];
+                break;
+            case Instruction::SUB:
+                --sp;
+                sp[-1] -= sp[0];
+                break;
+            case Instruction::MUL:
+                --sp;
+                sp[-1] *= sp[0];
+                break;
+            case Instruction::DIV:
+                --sp;
+                sp[-1] /= sp[0];
+                break;
+            case Instruction::SET_HEALTH:
+                sp -= 2;
+                healths[sp[0]] = sp[1];
+                break;
+            case Instruction::GET_HEALTH:
+                sp[-1] = healths[sp[-1]];
+                break;
+            case Instruction::PLAY_SOUND:
+                --sp;
+                break;
+            case Instruction::GET_HEALTH_IMM:
+                *sp++ = healths[instruction.argument];
+                break;
+            case Instruction::SET_HEALTH_IMM:
+                --sp;
+                healths[instruction.argument] = sp[0];
+                break;
+            case Instruction::ADD_IMM:
+                sp[-1] += instruction.argument;
+                break;
+            case Instruction::SUB_IMM:
+                sp[-1] -= instruction.argument;
+                break;
+            case Instruction::MUL_IMM:
+                sp[-1] *= instruction.argument;
+                break;
+            case Instruction::DIV_IMM:
+                sp[-1] /= instruction.argument;
+                break;
+            case Instruction::PLAY_SOUND_IMM:
+                break;
+        }
+    }
+
+    stack_.resize(spell.finalStackDepth());
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Counts every heap allocation in the process, so benchmarks can report
+// allocations per operation. It replaces the global operator new and delete
+// in all their C++14 forms, so memory allocated by one form is always freed
+// by its matching form. The operators are not inline: include this header
+// from exactly one source file of a program.
+
+static std::atomic<size_t> allocationCount(0);
+
+// GCC inlines the replacement operators into their callers and then sees
+// free() given a pointer from operator new, which -Wmismatched-new-delete
+// reports. Keeping the free() out of line hides the pairing from it.
+#if defined(__GNUC__) || defined(__clang__)
+#define ALLOCATION_COUNTER_NOINLINE __attribute__((noinline))
+#else
+#define ALLOCATION_COUNTER_NOINLINE
+#endif
+
+namespace allocation_counter {
+
+inline void* allocate(size_t size) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+ALLOCATION_COUNTER_NOINLINE inline void release(void* memory) noexcept {
+    std::free(memory);
+}
+
+} // namespace allocation_counter
+
+void* operator new(size_t size) {
+    if (void* memory = allocation_counter::allocate(size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    if (void* memory = allocation_counter::allocate(size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return allocation_counter::allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return allocation_counter::allocate(size);
+}
+
+void operator delete(void* memory) noexcept {
+    allocation_counter::release(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    allocation_counter::release(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    allocation_counter::release(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    allocation_counter::release(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    allocation_counter::release(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    allocation_counter::release(memory);
+}
@@ -0,0 +1,386 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Archetype storage
+// -----------------
+// GameObject keeps its components behind unique_ptrs, so updating N objects
+// means 3N virtual calls through pointers scattered over the heap. Here
+// components are plain structs and an entity is just an ID. Entities with the
+// same set of component types share an Archetype, which stores each type in
+// its own contiguous array (one column per type, one row per entity). A system
+// asks for the component types it needs and walks the rows of every matching
+// archetype in order, so the hot loop is a linear pass over a few arrays.
+//
+// Adding or removing a component moves the entity's row to the archetype for
+// its new set of types; that is how behaviours are swapped.
+
+using EntityId = std::uint32_t;
+using ComponentMask = std::uint64_t;
+
+const size_t maxComponentTypes = 64;
+
+// Dense IDs for component types, assigned the first time each type is used.
+// Components are copied around with memcpy, so they must be trivially copyable.
+class ComponentTypes
+{
+public:
+    template <typename T>
+    static size_t id()
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Components must be trivially copyable");
+        static const size_t value = add(sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    static ComponentMask bit()
+    {
+        return ComponentMask(1) << id<T>();
+    }
+
+    static size_t size(size_t id)
+    {
+        return sizes()[id];
+    }
+
+private:
+    // Component masks have one bit per type, so there can be no more types
+    static size_t add(size_t size)
+    {
+        std::vector<size_t> &all = sizes();
+        if (all.size() >= maxComponentTypes)
+        {
+            throw std::runtime_error("More than " + std::to_string(maxComponentTypes) + " component types");
+        }
+        all.push_back(size);
+        return all.size() - 1;
+    }
+
+    static std::vector<size_t> &sizes()
+    {
+        static std::vector<size_t> all;
+        return all;
+    }
+};
+
+// All entities that have exactly the component types in mask()
+class Archetype
+{
+public:
+    explicit Archetype(ComponentMask mask) : mask_(mask)
+    {
+        for (size_t type = 0; type < maxComponentTypes; ++type)
+        {
+            columnOf_[type] = -1;
+            if (mask & (ComponentMask(1) << type))
+            {
+                columnOf_[type] = static_cast<int>(columns_.size());
+                columns_.push_back({ComponentTypes::size(type), {}});
+            }
+        }
+    }
+
+    ComponentMask mask() const { return mask_; }
+    size_t size() const { return entities_.size(); }
+    EntityId entity(size_t row) const { return entities_[row]; }
+
+    bool has(size_t type) const { return columnOf_[type] >= 0; }
+
+    // The column of component T, one element per row. T may be const.
+    template <typename T>
+    T *data()
+    {
+        size_t type = ComponentTypes::id<typename std::remove_const<T>::type>();
+        assert(has(type));
+        return reinterpret_cast<T *>(columns_[columnOf_[type]].data.data());
+    }
+
+    void *at(size_t type, size_t row)
+    {
+        Column &column = columns_[columnOf_[type]];
+        return column.data.data() + row * column.elementSize;
+    }
+
+    // Appends an uninitialized row for `entity` and returns it
+    size_t addRow(EntityId entity)
+    {
+        for (Column &column : columns_)
+        {
+            column.data.resize(column.data.size() + column.elementSize);
+        }
+        entities_.push_back(entity);
+        return entities_.size() - 1;
+    }
+
+    // Fills the hole with the last row. Returns true if an entity was moved
+    // into `row`, which is then entity(row).
+    bool removeRow(size_t row)
+    {
+        size_t last = entities_.size() - 1;
+        for (Column &column : columns_)
+        {
+            if (row != last)
+            {
+                std::memcpy(column.data.data() + row * column.elementSize,
+                            column.data.data() + last * column.elementSize, column.elementSize);
+            }
+            column.data.resize(column.data.size() - column.elementSize);
+        }
+        entities_[row] = entities_[last];
+        entities_.pop_back();
+        return row != last;
+    }
+
+private:
+    struct Column
+    {
+        size_t elementSize;
+        std::vector<unsigned char> data; // new[] alignment suits any ordinary struct
+    };
+
+    ComponentMask mask_;
+    std::vector<Column> columns_;
+    std::vector<EntityId> entities_; // Row -> entity
+    int columnOf_[maxComponentTypes]; // Type ID -> index into columns_, -1 if absent
+};
+
+class ArchetypeWorld
+{
+public:
+    // Creates an entity with the given components
+    template <typename... Components>
+    EntityId create(const Components &...components)
+    {
+        EntityId entity = static_cast<EntityId>(locations_.size());
+        size_t archetype = archetypeFor(maskOf<Components...>());
+        size_t row = archetypes_[archetype]->addRow(entity);
+        locations_.push_back({archetype, row});
+        int expand[] = {0, (std::memcpy(archetypes_[archetype]->at(ComponentTypes::id<Components>(), row),
+                                        &components, sizeof(Components)),
+                            0)...};
+        (void)expand;
+        ++alive_;
+        return entity;
+    }
+
+    // Does nothing if the entity was already destroyed
+    void destroy(EntityId entity)
+    {
+        if (!alive(entity))
+        {
+            return;
+        }
+        Location &location = locations_[entity];
+        removeFrom(location);
+        location.archetype = dead;
+        --alive_;
+    }
+
+    bool alive(EntityId entity) const
+    {
+        return entity < locations_.size() && locations_[entity].archetype != dead;
+    }
+
+    // nullptr if the entity has no T or is not alive. Valid until the entity's
+    // components change.
+    template <typename T>
+    T *get(EntityId entity)
+    {
+        if (!alive(entity))
+        {
+            return nullptr;
+        }
+        const Location &location = locations_[entity];
+        Archetype &archetype = *archetypes_[location.archetype];
+        if (!archetype.has(ComponentTypes::id<T>()))
+        {
+            return nullptr;
+        }
+        return static_cast<T *>(archetype.at(ComponentTypes::id<T>(), location.row));
+    }
+
+    // Adds T to the entity, or overwrites it if the entity already has one.
+    // Does nothing if the entity is not alive.
+    template <typename T>
+    void add(EntityId entity, const T &component)
+    {
+        if (!alive(entity))
+        {
+            return;
+        }
+        if (T *existing = get<T>(entity))
+        {
+            *existing = component;
+            return;
+        }
+        moveTo(entity, archetypes_[locations_[entity].archetype]->mask() | ComponentTypes::bit<T>());
+        *get<T>(entity) = component;
+    }
+
+    // Does nothing if the entity is not alive or has no T
+    template <typename T>
+    void remove(EntityId entity)
+    {
+        if (!alive(entity))
+        {
+            return;
+        }
+        ComponentMask mask = archetypes_[locations_[entity].archetype]->mask();
+        if (mask & ComponentTypes::bit<T>())
+        {
+            moveTo(entity, mask & ~ComponentTypes::bit<T>());
+        }
+    }
+
+    // Calls fn(Components&...) for every entity that has all of Components,
+    // one archetype at a time. Ask for `const T` for components only read.
+    // fn must not add or remove components or entities.
+    template <typename... Components, typename Fn>
+    void each(Fn &&fn)
+    {
+        ComponentMask mask = maskOf<typename std::remove_const<Components>::type...>();
+        for (const auto &archetype : archetypes_)
+        {
+            if ((archetype->mask() & mask) == mask && archetype->size() > 0)
+            {
+                eachRow(fn, archetype->size(), archetype->template data<Components>()...);
+            }
+        }
+    }
+
+    size_t size() const { return alive_; }
+    const std::vector<std::unique_ptr<Archetype>> &archetypes() const { return archetypes_; }
+
+    template <typename... Components>
+    static ComponentMask maskOf()
+    {
+        ComponentMask mask = 0;
+        int expand[] = {0, (mask |= ComponentTypes::bit<Components>(), 0)...};
+        (void)expand;
+        return mask;
+    }
+
+private:
+    static const size_t dead = SIZE_MAX;
+
+    struct Location
+    {
+        size_t archetype; // Index into archetypes_, or dead
+        size_t row;
+    };
+
+    template <typename Fn, typename... Columns>
+    static void eachRow(Fn &fn, size_t count, Columns *...columns)
+    {
+        for (size_t row = 0; row < count; ++row)
+        {
+            fn(columns[row]...);
+        }
+    }
+
+    size_t archetypeFor(ComponentMask mask)
+    {
+        auto found = archetypeIndex_.find(mask);
+        if (found != archetypeIndex_.end())
+        {
+            return found->second;
+        }
+        archetypes_.emplace_back(new Archetype(mask));
+        archetypeIndex_[mask] = archetypes_.size() - 1;
+        return archetypes_.size() - 1;
+    }
+
+    // Copies the entity's components that exist in both archetypes to a new
+    // row; components new to the entity are left for the caller to set
+    void moveTo(EntityId entity, ComponentMask mask)
+    {
+        Location from = locations_[entity];
+        size_t target = archetypeFor(mask);
+        Archetype &source = *archetypes_[from.archetype];
+        Archetype &destination = *archetypes_[target];
+        size_t row = destination.addRow(entity);
+        for (size_t type = 0; type < maxComponentTypes; ++type)
+        {
+            if (source.has(type) && destination.has(type))
+            {
+                std::memcpy(destination.at(type, row), source.at(type, from.row), ComponentTypes::size(type));
+            }
+        }
+        removeFrom(from);
+        locations_[entity] = {target, row};
+    }
+
+    void removeFrom(const Location &location)
+    {
+        Archetype &archetype = *archetypes_[location.archetype];
+        if (archetype.removeRow(location.row))
+        {
+            locations_[archetype.entity(location.row)].row = location.row;
+        }
+    }
+
+    std::vector<std::unique_ptr<Archetype>> archetypes_; // Never shrinks, so indices stay valid
+    std::unordered_map<ComponentMask, size_t> archetypeIndex_;
+    std::vector<Location> locations_; // Indexed by EntityId; IDs are not reused
+    size_t alive_ = 0;
+};
+
+// The Input/Physics/Graphics behaviours of component.hpp as data and systems
+// --------------------------------------------------------------------------
+// InputComponent, AlternateInputComponent, PhysicsComponent and
+// GraphicsComponent become tag and data components, and each behaviour's
+// update() becomes a system that runs over every entity that has the
+// components it needs.
+
+struct Position
+{
+    double x;
+};
+
+struct Velocity
+{
+    double x;
+};
+
+struct PlayerInput // Tag: InputComponent
+{
+};
+
+struct AlternateInput // Tag: AlternateInputComponent
+{
+};
+
+struct Renderable // Tag: GraphicsComponent
+{
+};
+
+inline void inputSystem(ArchetypeWorld &world)
+{
+    world.each<Velocity, const PlayerInput>([](Velocity &velocity, const PlayerInput &) { velocity.x += 1; });
+}
+
+inline void alternateInputSystem(ArchetypeWorld &world)
+{
+    world.each<Velocity, const AlternateInput>([](Velocity &velocity, const AlternateInput &) { velocity.x -= 2; });
+}
+
+inline void physicsSystem(ArchetypeWorld &world)
+{
+    world.each<Position, const Velocity>([](Position &position, const Velocity &velocity) { position.x += velocity.x; });
+}
+
+// Calls render(position) for every entity with a Position and a Renderable
+template <typename Render>
+void graphicsSystem(ArchetypeWorld &world, Render &&render)
+{
+    world.each<const Position, const Renderable>([&](const Position &position, const Renderable &) { render(position); });
+}
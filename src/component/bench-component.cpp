@@ -0,0 +1,363 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include "component.hpp"
+#include "archetype-ecs.hpp"
+#include "system-scheduler.hpp"
+#include "sparse-set.hpp"
+#include "allocation-counter.hpp"
+
+// Benchmarks for the component storage. Pass the number of entity updates per
+// measurement as the first argument to override the default; each entity
+// count runs as many frames as it takes to reach it.
+
+namespace
+{
+
+template <typename Fn>
+double secondsFor(Fn &&fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+// InputComponent and PhysicsComponent without the console output, so the
+// benchmark measures the update and not std::cout
+class QuietInputComponent : public Component
+{
+public:
+    void update(GameObject *gameObject) override { gameObject->velocityX += 1; }
+};
+
+class QuietPhysicsComponent : public Component
+{
+public:
+    void update(GameObject *gameObject) override { gameObject->positionX += gameObject->velocityX; }
+};
+
+// A fresh heap hands out the objects nearly back to back, which flatters the
+// pointer design. After a game has been running for a while, neighbours in
+// the update order are rarely neighbours in memory; updating in a shuffled
+// order approximates that.
+double benchGameObjects(size_t entities, long frames, bool shuffled, double &checksum)
+{
+    std::vector<std::unique_ptr<GameObject>> objects;
+    objects.reserve(entities);
+    for (size_t i = 0; i < entities; ++i)
+    {
+        std::unique_ptr<GameObject> object(new GameObject);
+        object->addComponent(std::unique_ptr<Component>(new QuietInputComponent));
+        object->addComponent(std::unique_ptr<Component>(new QuietPhysicsComponent));
+        objects.push_back(std::move(object));
+    }
+    if (shuffled)
+    {
+        std::mt19937 random(42);
+        std::shuffle(objects.begin(), objects.end(), random);
+    }
+
+    double seconds = secondsFor([&] {
+        for (long frame = 0; frame < frames; ++frame)
+        {
+            for (const auto &object : objects)
+            {
+                object->updateComponents();
+            }
+        }
+    });
+    checksum = 0;
+    for (const auto &object : objects)
+    {
+        checksum += object->positionX;
+    }
+    return seconds;
+}
+
+double benchArchetypes(size_t entities, long frames, double &checksum)
+{
+    ArchetypeWorld world;
+    for (size_t i = 0; i < entities; ++i)
+    {
+        world.create(Position{0}, Velocity{0}, PlayerInput{});
+    }
+
+    double seconds = secondsFor([&] {
+        for (long frame = 0; frame < frames; ++frame)
+        {
+            inputSystem(world);
+            physicsSystem(world);
+        }
+    });
+    checksum = 0;
+    world.each<const Position>([&checksum](const Position &position) { checksum += position.x; });
+    return seconds;
+}
+
+void benchStorage(long updates)
+{
+    std::cout << "== GameObject::updateComponents() vs archetype systems (input + physics) ==" << std::endl;
+    for (size_t entities : {size_t(1000), size_t(100000), size_t(1000000)})
+    {
+        long frames = std::max(1L, updates / static_cast<long>(entities));
+        double perUpdate = 1e9 / (static_cast<double>(entities) * frames);
+
+        double inOrderChecksum, shuffledChecksum, archetypeChecksum;
+        double inOrder = benchGameObjects(entities, frames, false, inOrderChecksum);
+        double shuffled = benchGameObjects(entities, frames, true, shuffledChecksum);
+        double archetypes = benchArchetypes(entities, frames, archetypeChecksum);
+
+        bool same = inOrderChecksum == archetypeChecksum && shuffledChecksum == archetypeChecksum;
+        std::cout << entities << " entities x " << frames << " frames: "
+                  << "GameObject " << inOrder * perUpdate << " ns/entity, "
+                  << "GameObject shuffled " << shuffled * perUpdate << " ns/entity, "
+                  << "archetypes " << archetypes * perUpdate << " ns/entity, "
+                  << "speedup x" << inOrder / archetypes << " (x" << shuffled / archetypes << " shuffled)"
+                  << (same ? "" : " [RESULTS DIFFER]") << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+// Physics-heavy state: each frame integrates an orbit in several substeps
+struct Body
+{
+    double x, y, vx, vy;
+};
+
+void integrate(Body &body)
+{
+    const double dt = 0.001;
+    for (int step = 0; step < 16; ++step)
+    {
+        double distance = std::sqrt(body.x * body.x + body.y * body.y) + 0.1;
+        double pull = -1.0 / (distance * distance * distance);
+        body.vx += pull * body.x * dt;
+        body.vy += pull * body.y * dt;
+        body.x += body.vx * dt;
+        body.y += body.vy * dt;
+    }
+}
+
+void createBodies(ArchetypeWorld &world, size_t entities)
+{
+    for (size_t i = 0; i < entities; ++i)
+    {
+        double angle = static_cast<double>(i) * 0.001;
+        Body body{std::cos(angle) * 10, std::sin(angle) * 10, -std::sin(angle), std::cos(angle)};
+        if (i % 4 == 0)
+        {
+            world.create(body, Position{0}, Velocity{0}, PlayerInput{}, Renderable{}, Sprite{0});
+        }
+        else
+        {
+            world.create(body, Position{0}, Velocity{0}, AlternateInput{});
+        }
+    }
+}
+
+double bodyChecksum(ArchetypeWorld &world)
+{
+    double checksum = 0;
+    world.each<const Body, const Position>([&checksum](const Body &body, const Position &position) {
+        checksum += body.x * 3 + body.y + position.x;
+    });
+    return checksum;
+}
+
+void benchScheduler(long updates)
+{
+    const size_t entities = 200000;
+    long frames = std::max(1L, updates / static_cast<long>(entities) / 4);
+    std::cout << "== SystemScheduler: " << entities << " entities x " << frames
+              << " frames, component systems + 16-substep physics ==" << std::endl;
+
+    // Serial reference: the same systems with each<>(), no scheduler
+    ArchetypeWorld reference;
+    createBodies(reference, entities);
+    double serialSeconds = secondsFor([&] {
+        for (long frame = 0; frame < frames; ++frame)
+        {
+            inputSystem(reference);
+            alternateInputSystem(reference);
+            physicsSystem(reference);
+            reference.each<Sprite, const Position, const Renderable>([](Sprite &sprite, const Position &position,
+                                                                        const Renderable &) {
+                sprite.x = static_cast<float>(position.x * 0.5);
+            });
+            reference.each<Body>(integrate);
+        }
+    });
+    double expected = bodyChecksum(reference);
+    std::cout << "each<>() on one thread: " << serialSeconds / frames * 1e3 << " ms/frame" << std::endl;
+
+    size_t maxThreads = std::max<size_t>(4, std::thread::hardware_concurrency());
+    double oneThread = 0;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        ArchetypeWorld world;
+        createBodies(world, entities);
+        SystemScheduler scheduler(threads);
+        addComponentSystems(scheduler);
+        scheduler.add<Body>("orbits", integrate);
+
+        double seconds = secondsFor([&] {
+            for (long frame = 0; frame < frames; ++frame)
+            {
+                scheduler.run(world);
+            }
+        });
+        if (threads == 1)
+        {
+            oneThread = seconds;
+        }
+        std::cout << threads << " threads: " << seconds / frames * 1e3 << " ms/frame, "
+                  << "speedup x" << oneThread / seconds
+                  << (bodyChecksum(world) == expected ? "" : " [RESULTS DIFFER]") << std::endl;
+    }
+    std::cout << "(" << std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+    std::cout << std::endl;
+}
+
+// Swapping every entity's input behaviour back and forth, then looking up
+// the velocity of entities in random order
+void benchSwapsAndLookups()
+{
+    const size_t entities = 100000;
+    const int rounds = 10;
+    const double swaps = static_cast<double>(entities) * rounds;
+    std::cout << "== Swapping input behaviours and looking up components, " << entities << " entities ==" << std::endl;
+
+    // GameObject::swapComponent() prints a line per call; silence std::cout so
+    // the swap itself is measured
+    std::vector<std::unique_ptr<GameObject>> objects;
+    for (size_t i = 0; i < entities; ++i)
+    {
+        objects.emplace_back(new GameObject);
+        objects.back()->addComponent(std::unique_ptr<Component>(new QuietInputComponent));
+    }
+    std::cout.setstate(std::ios::badbit);
+    size_t allocations = allocationCount.load();
+    double objectSeconds = secondsFor([&] {
+        for (int round = 0; round < rounds; ++round)
+        {
+            for (const auto &object : objects)
+            {
+                object->swapComponent(std::unique_ptr<Component>(new QuietInputComponent));
+            }
+        }
+    });
+    double objectAllocations = (allocationCount.load() - allocations) / swaps;
+    std::cout.clear();
+
+    ArchetypeWorld archetypes;
+    std::vector<EntityId> ids;
+    for (size_t i = 0; i < entities; ++i)
+    {
+        ids.push_back(archetypes.create(Position{0}, Velocity{static_cast<double>(i)}, PlayerInput{}));
+    }
+    auto swapArchetypes = [&] {
+        for (EntityId id : ids)
+        {
+            archetypes.remove<PlayerInput>(id);
+            archetypes.add(id, AlternateInput{});
+        }
+        for (EntityId id : ids)
+        {
+            archetypes.remove<AlternateInput>(id);
+            archetypes.add(id, PlayerInput{});
+        }
+    };
+    swapArchetypes(); // Grows every archetype's columns once
+    allocations = allocationCount.load();
+    double archetypeSeconds = secondsFor([&] {
+        for (int round = 0; round < rounds / 2; ++round)
+        {
+            swapArchetypes();
+        }
+    });
+    double archetypeAllocations = (allocationCount.load() - allocations) / swaps;
+
+    SparseSetWorld pools;
+    std::vector<EntityHandle> handles;
+    pools.reserve<PlayerInput>(entities, entities);
+    pools.reserve<AlternateInput>(entities, entities);
+    for (size_t i = 0; i < entities; ++i)
+    {
+        handles.push_back(pools.create());
+        pools.add(handles.back(), Position{0});
+        pools.add(handles.back(), Velocity{static_cast<double>(i)});
+        pools.add(handles.back(), PlayerInput{});
+    }
+    allocations = allocationCount.load();
+    double sparseSeconds = secondsFor([&] {
+        for (int round = 0; round < rounds / 2; ++round)
+        {
+            for (EntityHandle handle : handles)
+            {
+                pools.swap<PlayerInput>(handle, AlternateInput{});
+            }
+            for (EntityHandle handle : handles)
+            {
+                pools.swap<AlternateInput>(handle, PlayerInput{});
+            }
+        }
+    });
+    double sparseAllocations = (allocationCount.load() - allocations) / swaps;
+
+    std::cout << "swap: GameObject " << objectSeconds / swaps * 1e9 << " ns (" << objectAllocations << " allocs), "
+              << "archetypes " << archetypeSeconds / swaps * 1e9 << " ns (" << archetypeAllocations << " allocs), "
+              << "sparse sets " << sparseSeconds / swaps * 1e9 << " ns (" << sparseAllocations << " allocs)"
+              << std::endl;
+
+    // GameObject has no lookup by component type, so only the ECS layouts
+    std::vector<size_t> order(entities);
+    for (size_t i = 0; i < entities; ++i)
+    {
+        order[i] = i;
+    }
+    std::mt19937 random(42);
+    std::shuffle(order.begin(), order.end(), random);
+    double archetypeSum = 0, sparseSum = 0;
+    double archetypeLookup = secondsFor([&] {
+        for (int round = 0; round < rounds; ++round)
+        {
+            for (size_t i : order)
+            {
+                archetypeSum += archetypes.get<Velocity>(ids[i])->x;
+            }
+        }
+    });
+    double sparseLookup = secondsFor([&] {
+        for (int round = 0; round < rounds; ++round)
+        {
+            for (size_t i : order)
+            {
+                sparseSum += pools.get<Velocity>(handles[i])->x;
+            }
+        }
+    });
+    std::cout << "random get<Velocity>(): archetypes " << archetypeLookup / swaps * 1e9 << " ns, "
+              << "sparse sets " << sparseLookup / swaps * 1e9 << " ns"
+              << (archetypeSum == sparseSum ? "" : " [RESULTS DIFFER]") << std::endl;
+    std::cout << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    long updates = argc > 1 ? std::atol(argv[1]) : 20000000;
+
+    benchStorage(updates);
+    benchScheduler(updates);
+    benchSwapsAndLookups();
+
+    return 0;
+}
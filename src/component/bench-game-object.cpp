@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "game-object.hpp"
+#include "static-game-object.hpp"
+
+// Benchmark for the split-design GameObject against StaticGameObject. Pass
+// the number of object updates per measurement as the first argument to
+// override the default.
+//
+// This is a separate program from bench_component because game-object.hpp
+// and component.hpp both define GameObject and Component.
+
+namespace
+{
+
+template <typename Fn>
+double secondsFor(Fn &&fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+// The behaviour both pipelines run, so their results can be compared exactly
+inline void steer(float &velocityX)
+{
+    velocityX += 0.5f;
+}
+
+inline void integrate(float &positionX, float &velocityX)
+{
+    positionX += velocityX * 0.016f;
+    velocityX *= 0.98f;
+}
+
+inline int toScreen(float positionX)
+{
+    return static_cast<int>(positionX * 4.0f);
+}
+
+// Dynamic components for GameObject
+class SteadyInputComponent : public InputComponent
+{
+public:
+    void handleInput(GameObject *gameObject) override { steer(gameObject->velocityX); }
+};
+
+class DampedPhysicsComponent : public PhysicsComponent
+{
+public:
+    void applyPhysics(GameObject *gameObject) override { integrate(gameObject->positionX, gameObject->velocityX); }
+};
+
+class ScreenGraphicsComponent : public GraphicsComponent
+{
+public:
+    void render(GameObject *gameObject) override { drawnX = toScreen(gameObject->positionX); }
+    int drawnX = 0;
+};
+
+// The same components for StaticGameObject
+struct SteadyInput
+{
+    template <typename Object>
+    void update(Object &object) { steer(object.velocityX); }
+};
+
+struct DampedPhysics
+{
+    template <typename Object>
+    void update(Object &object) { integrate(object.positionX, object.velocityX); }
+};
+
+struct ScreenGraphics
+{
+    template <typename Object>
+    void update(Object &object) { drawnX = toScreen(object.positionX); }
+    int drawnX = 0;
+};
+
+using StaticPlayer = StaticGameObject<SteadyInput, DampedPhysics, ScreenGraphics>;
+
+double benchDynamic(size_t objects, long frames, long &checksum)
+{
+    std::vector<std::unique_ptr<GameObject>> world;
+    for (size_t i = 0; i < objects; ++i)
+    {
+        world.emplace_back(new GameObject(std::unique_ptr<InputComponent>(new SteadyInputComponent),
+                                          std::unique_ptr<PhysicsComponent>(new DampedPhysicsComponent),
+                                          std::unique_ptr<GraphicsComponent>(new ScreenGraphicsComponent)));
+        world.back()->positionX = static_cast<float>(i);
+    }
+    double seconds = secondsFor([&] {
+        for (long frame = 0; frame < frames; ++frame)
+        {
+            for (const auto &object : world)
+            {
+                object->updateComponents();
+            }
+        }
+    });
+    checksum = 0;
+    for (const auto &object : world)
+    {
+        checksum += static_cast<ScreenGraphicsComponent &>(*object->graphicsComponent_).drawnX;
+    }
+    return seconds;
+}
+
+// Static dispatch, but every object still behind its own heap allocation,
+// to separate the cost of the calls and component pointers from the cost of
+// the objects' layout
+double benchStaticBoxed(size_t objects, long frames, long &checksum)
+{
+    std::vector<std::unique_ptr<StaticPlayer>> world;
+    for (size_t i = 0; i < objects; ++i)
+    {
+        world.emplace_back(new StaticPlayer(SteadyInput(), DampedPhysics(), ScreenGraphics()));
+        world.back()->positionX = static_cast<float>(i);
+    }
+    double seconds = secondsFor([&] {
+        for (long frame = 0; frame < frames; ++frame)
+        {
+            for (const auto &object : world)
+            {
+                object->update();
+            }
+        }
+    });
+    checksum = 0;
+    for (const auto &object : world)
+    {
+        checksum += object->component<ScreenGraphics>().drawnX;
+    }
+    return seconds;
+}
+
+double benchStatic(size_t objects, long frames, long &checksum)
+{
+    std::vector<StaticPlayer> world;
+    for (size_t i = 0; i < objects; ++i)
+    {
+        world.emplace_back(SteadyInput(), DampedPhysics(), ScreenGraphics());
+        world.back().positionX = static_cast<float>(i);
+    }
+    double seconds = secondsFor([&] {
+        for (long frame = 0; frame < frames; ++frame)
+        {
+            for (StaticPlayer &object : world)
+            {
+                object.update();
+            }
+        }
+    });
+    checksum = 0;
+    for (StaticPlayer &object : world)
+    {
+        checksum += object.component<ScreenGraphics>().drawnX;
+    }
+    return seconds;
+}
+
+void benchDispatch(long updates)
+{
+    std::cout << "== GameObject::updateComponents() vs StaticGameObject::update() (input, physics, graphics) =="
+              << std::endl;
+    for (size_t objects : {size_t(1000), size_t(100000)})
+    {
+        long frames = std::max(1L, updates / static_cast<long>(objects));
+        double perUpdate = 1e9 / (static_cast<double>(objects) * frames);
+
+        long dynamicChecksum, boxedChecksum, staticChecksum;
+        double dynamic = benchDynamic(objects, frames, dynamicChecksum);
+        double boxed = benchStaticBoxed(objects, frames, boxedChecksum);
+        double inlined = benchStatic(objects, frames, staticChecksum);
+
+        bool same = dynamicChecksum == staticChecksum && boxedChecksum == staticChecksum;
+        std::cout << objects << " objects x " << frames << " frames: "
+                  << "GameObject " << dynamic * perUpdate << " ns/object, "
+                  << "StaticGameObject behind pointers " << boxed * perUpdate << " ns/object, "
+                  << "StaticGameObject by value " << inlined * perUpdate << " ns/object, "
+                  << "speedup x" << dynamic / inlined
+                  << " (x" << dynamic / boxed << " with objects still behind pointers)"
+                  << (same ? "" : " [RESULTS DIFFER]") << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    long updates = argc > 1 ? std::atol(argv[1]) : 20000000;
+
+    benchDispatch(updates);
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <memory>
+
+// Component Interface
+class Component
+{
+public:
+    virtual ~Component() = default;
+    virtual void update(class GameObject *gameObject) = 0;
+};
+
+// GameObject (Entity) - Container for Components and Shared State
+class GameObject
+{
+public:
+    // Shared State
+    double positionX;
+    double velocityX;
+
+    GameObject() : positionX(0), velocityX(0) {}
+
+    void addComponent(std::unique_ptr<Component> component)
+    {
+        components_.push_back(std::move(component));
+    }
+
+    void update()
+    {
+        std::cout << "GameObject: Updating components..." << std::endl;
+        updateComponents();
+        std::cout << "GameObject: --- Update End ---" << std::endl;
+    }
+
+    // update() without the control prints
+    void updateComponents()
+    {
+        for (const auto &component : components_)
+        {
+            component->update(this); // Pass GameObject for shared state access
+        }
+    }
+
+    // Method to swap a component of a certain type (simple implementation)
+    void swapComponent(std::unique_ptr<Component> newComponent)
+    {
+        // Identify the type of the new component and try to replace an existing one
+        // For simplicity, we'll just clear and add here, a more robust solution would
+        // identify by component type.
+        std::cout << "GameObject: Swapping a component." << std::endl;
+        components_.clear();
+        components_.push_back(std::move(newComponent));
+    }
+
+private:
+    std::vector<std::unique_ptr<Component>> components_;
+};
+
+// Concrete Input Component
+class InputComponent : public Component
+{
+public:
+    void update(GameObject *gameObject) override
+    {
+        std::cout << "Input Component: Processing input." << std::endl;
+        // Simulate input affecting velocity
+        gameObject->velocityX += 1;
+        std::cout << "Input Component: Increased velocity to " << gameObject->velocityX << "." << std::endl;
+    }
+};
+
+// Concrete Physics Component
+class PhysicsComponent : public Component
+{
+public:
+    void update(GameObject *gameObject) override
+    {
+        std::cout << "Physics Component: Applying physics." << std::endl;
+        // Simulate physics affecting position based on velocity
+        gameObject->positionX += gameObject->velocityX;
+        std::cout << "Physics Component: Moved to position " << gameObject->positionX << "." << std::endl;
+    }
+};
+
+// Concrete Graphics Component
+class GraphicsComponent : public Component
+{
+public:
+    void update(GameObject *gameObject) override
+    {
+        std::cout << "Graphics Component: Rendering at position " << gameObject->positionX << "." << std::endl;
+    }
+};
+
+// Another Concrete Input Component (for swapping)
+class AlternateInputComponent : public Component
+{
+public:
+    void update(GameObject *gameObject) override
+    {
+        std::cout << "Alternate Input Component: Processing different input." << std::endl;
+        // Simulate different input affecting velocity
+        gameObject->velocityX -= 2;
+        std::cout << "Alternate Input Component: Decreased velocity to " << gameObject->velocityX << "." << std::endl;
+    }
+};
@@ -8,6 +8,11 @@ class GraphicsComponent;
 
 
 void GameObject::update() {
+    updateComponents();
+    std::cout << "GameObject: --- Frame End ---" << std::endl;
+}
+
+void GameObject::updateComponents() {
     if (inputComponent_) {
         inputComponent_->update(this);
     }
@@ -17,7 +22,6 @@ void GameObject::update() {
     if (graphicsComponent_) {
         graphicsComponent_->update(this);
     }
-    std::cout << "GameObject: --- Frame End ---" << std::endl;
 }
     
 // Method to swap the Input Component
@@ -23,6 +23,9 @@ public:
 
     void update();
 
+    // update() without the control print
+    void updateComponents();
+
     // Commonly shared state (managed by the GameObject)
     float positionX = 0.0f;
     float velocityX = 0.0f;
@@ -31,9 +34,9 @@ public:
     void swapInputComponent(std::unique_ptr<InputComponent> newInput);
 
 // private: making those public just to simplify example reuse of components
-    std::unique_ptr<GraphicsComponent> graphicsComponent_;
     std::unique_ptr<InputComponent> inputComponent_;
     std::unique_ptr<PhysicsComponent> physicsComponent_;
+    std::unique_ptr<GraphicsComponent> graphicsComponent_;
 };
 
 // Component Interface
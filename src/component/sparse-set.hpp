@@ -0,0 +1,339 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "archetype-ecs.hpp"
+
+// Sparse-set storage
+// ------------------
+// A second way to store components: one pool per component type instead of
+// one table per combination of types. Each pool is a sparse set:
+//
+//   sparse: entity index -> position in dense, or noComponentSlot
+//   dense:  the components, packed, plus the handle owning each
+//
+// Lookup, add and remove are O(1): remove moves the last component into the
+// hole. Iterating a pool walks the dense array in order. Adding or removing
+// a component touches only that type's pool, so swapping one behaviour for
+// another moves no other data, and once the pools have grown it allocates
+// nothing; GameObject::swapComponent frees and allocates every time.
+//
+// Entities are generational handles. Destroying an entity bumps the
+// generation of its index before the index is reused, so a handle kept from
+// before is recognised as stale instead of silently pointing at a new entity.
+
+struct EntityHandle
+{
+    std::uint32_t index;
+    std::uint32_t generation;
+
+    bool operator==(const EntityHandle &other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const EntityHandle &other) const { return !(*this == other); }
+};
+
+// Hands out handles and recycles the indices of destroyed entities
+class EntityRegistry
+{
+public:
+    EntityHandle create()
+    {
+        if (!free_.empty())
+        {
+            std::uint32_t index = free_.back();
+            free_.pop_back();
+            return {index, generations_[index]};
+        }
+        generations_.push_back(0);
+        return {static_cast<std::uint32_t>(generations_.size() - 1), 0};
+    }
+
+    // Returns false if the handle was already stale
+    bool destroy(EntityHandle entity)
+    {
+        if (!alive(entity))
+        {
+            return false;
+        }
+        ++generations_[entity.index];
+        free_.push_back(entity.index);
+        return true;
+    }
+
+    bool alive(EntityHandle entity) const
+    {
+        return entity.index < generations_.size() && generations_[entity.index] == entity.generation;
+    }
+
+    // One past the highest index handed out so far
+    size_t capacity() const { return generations_.size(); }
+
+private:
+    std::vector<std::uint32_t> generations_; // Current generation of each index
+    std::vector<std::uint32_t> free_;
+};
+
+// Marks an entity index without a component in a ComponentPool
+const std::uint32_t noComponentSlot = UINT32_MAX;
+
+class ComponentPoolBase
+{
+public:
+    virtual ~ComponentPoolBase() = default;
+    virtual bool remove(EntityHandle entity) = 0;
+};
+
+template <typename T>
+class ComponentPool : public ComponentPoolBase
+{
+public:
+    void reserve(size_t entities, size_t components)
+    {
+        if (sparse_.size() < entities)
+        {
+            sparse_.resize(entities, noComponentSlot);
+        }
+        dense_.reserve(components);
+        owners_.reserve(components);
+    }
+
+    bool has(EntityHandle entity) const { return slotOf(entity) != noComponentSlot; }
+
+    // nullptr if the entity has no T. Valid until the pool changes.
+    T *get(EntityHandle entity)
+    {
+        std::uint32_t slot = slotOf(entity);
+        return slot == noComponentSlot ? nullptr : &dense_[slot];
+    }
+
+    // Adds T to the entity, or overwrites it if the entity already has one
+    T &add(EntityHandle entity, T component)
+    {
+        std::uint32_t slot = slotOf(entity);
+        if (slot != noComponentSlot)
+        {
+            dense_[slot] = std::move(component);
+            return dense_[slot];
+        }
+        if (entity.index >= sparse_.size())
+        {
+            sparse_.resize(entity.index + 1, noComponentSlot);
+        }
+        // A slot still held by an older generation of this index is taken
+        // over; one held by a newer generation means `entity` is stale
+        std::uint32_t held = sparse_[entity.index];
+        if (held != noComponentSlot)
+        {
+            if (owners_[held].generation > entity.generation)
+            {
+                throw std::runtime_error("Stale entity handle " + std::to_string(entity.index) + ":" +
+                                         std::to_string(entity.generation));
+            }
+            removeSlot(held);
+        }
+        sparse_[entity.index] = static_cast<std::uint32_t>(dense_.size());
+        dense_.push_back(std::move(component));
+        owners_.push_back(entity);
+        return dense_.back();
+    }
+
+    bool remove(EntityHandle entity) override
+    {
+        std::uint32_t slot = slotOf(entity);
+        if (slot == noComponentSlot)
+        {
+            return false;
+        }
+        removeSlot(slot);
+        return true;
+    }
+
+    // Calls fn(EntityHandle, T&) for every component, in dense order. fn must
+    // not add or remove T.
+    template <typename Fn>
+    void each(Fn &&fn)
+    {
+        for (size_t slot = 0; slot < dense_.size(); ++slot)
+        {
+            fn(owners_[slot], dense_[slot]);
+        }
+    }
+
+    size_t size() const { return dense_.size(); }
+    T *data() { return dense_.data(); }
+    const EntityHandle *owners() const { return owners_.data(); }
+
+private:
+    std::uint32_t slotOf(EntityHandle entity) const
+    {
+        if (entity.index >= sparse_.size())
+        {
+            return noComponentSlot;
+        }
+        std::uint32_t slot = sparse_[entity.index];
+        return slot != noComponentSlot && owners_[slot].generation == entity.generation ? slot : noComponentSlot;
+    }
+
+    void removeSlot(std::uint32_t slot)
+    {
+        std::uint32_t last = static_cast<std::uint32_t>(dense_.size() - 1);
+        sparse_[owners_[slot].index] = noComponentSlot;
+        if (slot != last)
+        {
+            dense_[slot] = std::move(dense_[last]);
+            owners_[slot] = owners_[last];
+            sparse_[owners_[slot].index] = slot;
+        }
+        dense_.pop_back(); // Keeps the capacity, so adding again does not allocate
+        owners_.pop_back();
+    }
+
+    std::vector<std::uint32_t> sparse_; // Entity index -> slot in dense_, or noComponentSlot
+    std::vector<T> dense_;
+    std::vector<EntityHandle> owners_; // Slot -> entity
+};
+
+// Entities and one ComponentPool per component type
+class SparseSetWorld
+{
+public:
+    EntityHandle create() { return registry_.create(); }
+
+    // Removes the entity's components; its handle and any copies go stale
+    void destroy(EntityHandle entity)
+    {
+        if (!registry_.alive(entity))
+        {
+            return;
+        }
+        for (const auto &pool : pools_)
+        {
+            if (pool)
+            {
+                pool->remove(entity);
+            }
+        }
+        registry_.destroy(entity);
+    }
+
+    bool alive(EntityHandle entity) const { return registry_.alive(entity); }
+
+    template <typename T>
+    ComponentPool<T> &pool()
+    {
+        size_t type = ComponentTypes::id<T>();
+        if (pools_.size() <= type)
+        {
+            pools_.resize(type + 1);
+        }
+        if (!pools_[type])
+        {
+            pools_[type].reset(new ComponentPool<T>);
+        }
+        return static_cast<ComponentPool<T> &>(*pools_[type]);
+    }
+
+    // Throws std::runtime_error for a stale handle, which would otherwise
+    // take over the component of the entity now using its index
+    template <typename T>
+    T &add(EntityHandle entity, T component)
+    {
+        requireAlive(entity);
+        return pool<T>().add(entity, std::move(component));
+    }
+
+    template <typename T>
+    bool remove(EntityHandle entity)
+    {
+        return pool<T>().remove(entity);
+    }
+
+    // nullptr if the entity has no T or the handle is stale
+    template <typename T>
+    T *get(EntityHandle entity)
+    {
+        return pool<T>().get(entity);
+    }
+
+    // Replaces the entity's From with a To, e.g. PlayerInput with
+    // AlternateInput. Allocates nothing once To's pool has room. Throws
+    // std::runtime_error for a stale handle, like add().
+    template <typename From, typename To>
+    To &swap(EntityHandle entity, To component)
+    {
+        requireAlive(entity);
+        remove<From>(entity);
+        return add<To>(entity, std::move(component));
+    }
+
+    // Makes room for `entities` entities and `components` of type T
+    template <typename T>
+    void reserve(size_t entities, size_t components)
+    {
+        pool<T>().reserve(entities, components);
+    }
+
+private:
+    void requireAlive(EntityHandle entity) const
+    {
+        if (!alive(entity))
+        {
+            throw std::runtime_error("Stale entity handle " + std::to_string(entity.index) + ":" +
+                                     std::to_string(entity.generation));
+        }
+    }
+
+    EntityRegistry registry_;
+    std::vector<std::unique_ptr<ComponentPoolBase>> pools_; // Indexed by ComponentTypes::id<T>()
+};
+
+// The systems of archetype-ecs.hpp over sparse sets. Each walks the pool of
+// the component that selects entities and looks the others up by handle.
+
+inline void inputSystem(SparseSetWorld &world)
+{
+    ComponentPool<Velocity> &velocities = world.pool<Velocity>();
+    world.pool<PlayerInput>().each([&velocities](EntityHandle entity, PlayerInput &) {
+        if (Velocity *velocity = velocities.get(entity))
+        {
+            velocity->x += 1;
+        }
+    });
+}
+
+inline void alternateInputSystem(SparseSetWorld &world)
+{
+    ComponentPool<Velocity> &velocities = world.pool<Velocity>();
+    world.pool<AlternateInput>().each([&velocities](EntityHandle entity, AlternateInput &) {
+        if (Velocity *velocity = velocities.get(entity))
+        {
+            velocity->x -= 2;
+        }
+    });
+}
+
+inline void physicsSystem(SparseSetWorld &world)
+{
+    ComponentPool<Position> &positions = world.pool<Position>();
+    world.pool<Velocity>().each([&positions](EntityHandle entity, Velocity &velocity) {
+        if (Position *position = positions.get(entity))
+        {
+            position->x += velocity.x;
+        }
+    });
+}
+
+template <typename Render>
+void graphicsSystem(SparseSetWorld &world, Render &&render)
+{
+    ComponentPool<Position> &positions = world.pool<Position>();
+    world.pool<Renderable>().each([&](EntityHandle entity, Renderable &) {
+        if (const Position *position = positions.get(entity))
+        {
+            render(*position);
+        }
+    });
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <tuple>
+#include <utility>
+
+// Static component pipelines
+// --------------------------
+// GameObject (game-object.hpp) reaches each of its components through a
+// unique_ptr and a virtual update(), so components can be swapped at runtime,
+// but every frame pays for the pointer loads and indirect calls, and the
+// compiler cannot inline across them. Many kinds of entity never swap
+// anything: their component set is fixed when the code is written.
+//
+// StaticGameObject<Input, Physics, Graphics> takes the component types as
+// template arguments and stores the components by value, inside the object.
+// update() calls each one's update() directly, in order, so the calls are
+// resolved at compile time and the whole pipeline can be inlined into one
+// function. Components are plain classes with a member template
+//
+//   template <typename Object> void update(Object &object);
+//
+// reading and writing the same shared state as GameObject's components. Any
+// number of components works; GameObject stays the path for entities whose
+// components change while the game runs.
+template <typename... Components>
+class StaticGameObject
+{
+public:
+    explicit StaticGameObject(Components... components) : components_(std::move(components)...) {}
+
+    // Runs every component once, in the order of the template arguments
+    void update()
+    {
+        updateEach(std::index_sequence_for<Components...>());
+    }
+
+    // The component of type C. Each type may appear only once.
+    template <typename C>
+    C &component()
+    {
+        return std::get<C>(components_);
+    }
+
+    // Commonly shared state, as in GameObject
+    float positionX = 0.0f;
+    float velocityX = 0.0f;
+
+private:
+    template <size_t... Indices>
+    void updateEach(std::index_sequence<Indices...>)
+    {
+        int expand[] = {0, (std::get<Indices>(components_).update(*this), 0)...};
+        (void)expand;
+    }
+
+    std::tuple<Components...> components_;
+};
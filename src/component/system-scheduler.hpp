@@ -0,0 +1,397 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "archetype-ecs.hpp"
+
+// Parallel systems
+// ----------------
+// A system is a function over every entity that has a given set of
+// components. Its parameter types say what it touches: `T&` writes T,
+// `const T&` only reads it. SystemScheduler::run() turns the systems into a
+// dependency graph for the current set of archetypes:
+//
+// *   Two systems conflict if some archetype matches both and one of them
+//     writes a component the other reads or writes there. The later system
+//     (in the order they were added) waits for the earlier one. Systems that
+//     do not conflict run at the same time.
+// *   Each system's work is split into chunks of up to chunkSize rows of one
+//     archetype. Chunks of a ready system go to the workers' deques; a worker
+//     takes work from the back of its own deque and, when that is empty,
+//     steals from the front of another's.
+//
+// Every chunk writes only its own rows, and conflicting systems run in the
+// order they were added, so each frame produces exactly what a serial run in
+// that order would, whatever the thread count or timing. System functions
+// must only write the components they are given, and world structure (create,
+// destroy, add, remove) must not change during run().
+class SystemScheduler
+{
+public:
+    static const size_t chunkSize = 4096; // Rows of one archetype per task
+
+    explicit SystemScheduler(size_t threads = std::thread::hardware_concurrency())
+    {
+        threads = std::max<size_t>(threads, 1);
+        for (size_t i = 0; i < threads; ++i)
+        {
+            workers_.emplace_back(new Worker);
+        }
+        // The thread calling run() acts as worker 0
+        for (size_t i = 1; i < threads; ++i)
+        {
+            pool_.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~SystemScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread &thread : pool_)
+        {
+            thread.join();
+        }
+    }
+
+    SystemScheduler(const SystemScheduler &) = delete;
+    SystemScheduler &operator=(const SystemScheduler &) = delete;
+
+    size_t threads() const { return workers_.size(); }
+
+    // Adds a system calling fn(Components&...) for every entity that has all
+    // of Components. Declare components the system only reads as `const T`.
+    template <typename... Components, typename Fn>
+    void add(std::string name, Fn fn)
+    {
+        System system;
+        system.name = std::move(name);
+        system.reads = ArchetypeWorld::maskOf<typename std::remove_const<Components>::type...>();
+        system.writes = writeMask<Components...>();
+        system.run = [fn](Archetype &archetype, size_t begin, size_t end) {
+            runRows(fn, begin, end, archetype.template data<Components>()...);
+        };
+        systems_.push_back(std::move(system));
+    }
+
+    // Runs every system once over `world`. Rethrows the first exception a
+    // system threw, after the frame has finished.
+    void run(ArchetypeWorld &world)
+    {
+        if (systems_.empty())
+        {
+            return;
+        }
+        buildGraph(world);
+        systemsLeft_.store(systems_.size());
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            busy_ = pool_.size();
+            ++generation_;
+        }
+        // Workers may already be finishing roots and releasing their
+        // dependents, so roots are picked by the graph, not by waitingFor
+        for (size_t system = 0; system < systems_.size(); ++system)
+        {
+            if (nodes_[system].dependencies.empty())
+            {
+                release(system, 0);
+            }
+        }
+        wake_.notify_all();
+        work(0);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_.wait(lock, [this] { return busy_ == 0; });
+        }
+        if (error_)
+        {
+            std::exception_ptr error = error_;
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Systems the i-th system waited for in the last run(), for inspection
+    const std::vector<size_t> &dependencies(size_t system) const { return nodes_[system].dependencies; }
+    const std::string &name(size_t system) const { return systems_[system].name; }
+    size_t size() const { return systems_.size(); }
+
+private:
+    struct System
+    {
+        std::string name;
+        ComponentMask reads; // Every component the system is given
+        ComponentMask writes; // Those given as non-const
+        std::function<void(Archetype &, size_t, size_t)> run;
+    };
+
+    struct Task
+    {
+        size_t system;
+        Archetype *archetype;
+        size_t begin;
+        size_t end;
+    };
+
+    // A system in this frame's graph
+    struct Node
+    {
+        std::vector<Archetype *> archetypes; // Matching and not empty
+        std::vector<size_t> dependencies;
+        std::vector<size_t> dependents;
+        std::atomic<size_t> waitingFor{0}; // Dependencies not finished yet
+        std::atomic<size_t> tasksLeft{0};
+        size_t taskCount = 0;
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks; // Owner pops the back, thieves the front
+    };
+
+    template <typename... Components>
+    static ComponentMask writeMask()
+    {
+        ComponentMask mask = 0;
+        int expand[] = {0, (mask |= std::is_const<Components>::value
+                                        ? 0
+                                        : ComponentTypes::bit<typename std::remove_const<Components>::type>(),
+                            0)...};
+        (void)expand;
+        return mask;
+    }
+
+    template <typename Fn, typename... Columns>
+    static void runRows(const Fn &fn, size_t begin, size_t end, Columns *...columns)
+    {
+        for (size_t row = begin; row < end; ++row)
+        {
+            fn(columns[row]...);
+        }
+    }
+
+    void buildGraph(ArchetypeWorld &world)
+    {
+        size_t count = systems_.size();
+        if (nodeCount_ != count)
+        {
+            nodes_.reset(new Node[count]);
+            nodeCount_ = count;
+        }
+        for (size_t system = 0; system < count; ++system)
+        {
+            Node &node = nodes_[system];
+            node.archetypes.clear(); // Keep their capacity from earlier frames
+            node.dependencies.clear();
+            node.dependents.clear();
+            node.taskCount = 0;
+            for (const auto &archetype : world.archetypes())
+            {
+                ComponentMask reads = systems_[system].reads;
+                if ((archetype->mask() & reads) == reads && archetype->size() > 0)
+                {
+                    node.archetypes.push_back(archetype.get());
+                    node.taskCount += (archetype->size() + chunkSize - 1) / chunkSize;
+                }
+            }
+            node.tasksLeft.store(node.taskCount, std::memory_order_relaxed);
+
+            // Only archetypes both systems touch can make them conflict
+            for (size_t earlier = 0; earlier < system; ++earlier)
+            {
+                if (conflict(earlier, system))
+                {
+                    node.dependencies.push_back(earlier);
+                    nodes_[earlier].dependents.push_back(system);
+                }
+            }
+            node.waitingFor.store(node.dependencies.size(), std::memory_order_relaxed);
+        }
+    }
+
+    bool conflict(size_t a, size_t b) const
+    {
+        const System &first = systems_[a];
+        const System &second = systems_[b];
+        if (!(first.writes & second.reads) && !(second.writes & first.reads))
+        {
+            return false;
+        }
+        for (Archetype *archetype : nodes_[a].archetypes)
+        {
+            const std::vector<Archetype *> &shared = nodes_[b].archetypes;
+            if (std::find(shared.begin(), shared.end(), archetype) != shared.end())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Queues the system's chunks, spread over the workers starting with `worker`
+    void release(size_t system, size_t worker)
+    {
+        Node &node = nodes_[system];
+        if (node.taskCount == 0)
+        {
+            finish(system, worker);
+            return;
+        }
+        size_t target = worker;
+        for (Archetype *archetype : node.archetypes)
+        {
+            for (size_t begin = 0; begin < archetype->size(); begin += chunkSize)
+            {
+                Worker &queue = *workers_[target];
+                {
+                    std::lock_guard<std::mutex> lock(queue.mutex);
+                    queue.tasks.push_back({system, archetype, begin, std::min(begin + chunkSize, archetype->size())});
+                }
+                target = (target + 1) % workers_.size();
+            }
+        }
+    }
+
+    void finish(size_t system, size_t worker)
+    {
+        for (size_t dependent : nodes_[system].dependents)
+        {
+            if (nodes_[dependent].waitingFor.fetch_sub(1) == 1)
+            {
+                release(dependent, worker);
+            }
+        }
+        systemsLeft_.fetch_sub(1);
+    }
+
+    bool takeTask(size_t worker, Task &task)
+    {
+        {
+            Worker &own = *workers_[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                task = own.tasks.back();
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t offset = 1; offset < workers_.size(); ++offset)
+        {
+            Worker &victim = *workers_[(worker + offset) % workers_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Runs and steals tasks until every system of the frame has finished
+    void work(size_t worker)
+    {
+        Task task;
+        while (systemsLeft_.load() > 0)
+        {
+            if (!takeTask(worker, task))
+            {
+                std::this_thread::yield(); // Waiting for a dependency to finish
+                continue;
+            }
+            try
+            {
+                systems_[task.system].run(*task.archetype, task.begin, task.end);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!error_) error_ = std::current_exception();
+            }
+            if (nodes_[task.system].tasksLeft.fetch_sub(1) == 1)
+            {
+                finish(task.system, worker);
+            }
+        }
+    }
+
+    void workerLoop(size_t worker)
+    {
+        unsigned long seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+                if (stopping_)
+                {
+                    return;
+                }
+                seen = generation_;
+            }
+            work(worker);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                --busy_;
+            }
+            done_.notify_one();
+        }
+    }
+
+    std::vector<System> systems_;
+    std::unique_ptr<Node[]> nodes_; // Indexed like systems_, rebuilt by every run()
+    size_t nodeCount_ = 0;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> pool_;
+    std::atomic<size_t> systemsLeft_{0};
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    unsigned long generation_ = 0;
+    size_t busy_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+};
+
+// The behaviours of component.hpp as scheduled systems. Render prep turns each
+// rendered Position into a Sprite, which the serial draw pass then reads.
+
+struct Sprite
+{
+    float x; // Screen space
+};
+
+inline void addComponentSystems(SystemScheduler &scheduler)
+{
+    scheduler.add<Velocity, const PlayerInput>("input", [](Velocity &velocity, const PlayerInput &) {
+        velocity.x += 1;
+    });
+    scheduler.add<Velocity, const AlternateInput>("alternate input", [](Velocity &velocity, const AlternateInput &) {
+        velocity.x -= 2;
+    });
+    scheduler.add<Position, const Velocity>("physics", [](Position &position, const Velocity &velocity) {
+        position.x += velocity.x;
+    });
+    scheduler.add<Sprite, const Position, const Renderable>("render prep", [](Sprite &sprite, const Position &position,
+                                                                               const Renderable &) {
+        sprite.x = static_cast<float>(position.x * 0.5); // World units to pixels
+    });
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "event-queue.hpp"
+#include "concurrent-event-queue.hpp"
+
+// Listeners on worker threads
+// ---------------------------
+// processEvents() calls every listener on its own thread, so one slow listener
+// (a logger flushing std::cout, say) delays all the others and the frame.
+// Wrapping a listener in an AsyncListener moves it to a ListenerWorker: the
+// queue's thread only hands the event over through the AsyncListener's own
+// SpscRing, and the worker thread calls the real listener later. Each listener
+// sees its events in order, and listeners pinned to the same worker never run
+// concurrently, so a worker doubles as a strand for listeners that share
+// state. Across listeners there is no order: the worker takes a batch from
+// each in turn, so one listener may handle events 1..64 before another sees
+// event 1.
+//
+// Events are shared between threads, so listeners on workers must only read
+// them. If a worker falls behind and an AsyncListener's ring fills up, further
+// events are dropped for that listener alone and counted; the frame never
+// waits for a slow consumer.
+
+class AsyncListener;
+
+class ListenerWorker {
+public:
+    ListenerWorker() : thread_([this] { run(); }) {}
+
+    // Every AsyncListener pinned to this worker must be destroyed first
+    ~ListenerWorker() {
+        stopping_ = true;
+        wake_.notify_one();
+        thread_.join();
+    }
+
+private:
+    friend class AsyncListener;
+
+    void attach(AsyncListener* listener) {
+        std::lock_guard<std::mutex> lock(listenersMutex_);
+        listeners_.push_back(listener);
+    }
+
+    // Waits if the worker is delivering to `listener` right now
+    void detach(AsyncListener* listener) {
+        std::lock_guard<std::mutex> lock(listenersMutex_);
+        listeners_.erase(std::remove(listeners_.begin(), listeners_.end(), listener), listeners_.end());
+    }
+
+    // Called by an AsyncListener after handing over an event
+    void notify() {
+        if (sleeping_) {
+            wake_.notify_one();
+        }
+    }
+
+    inline void run();
+
+    std::mutex listenersMutex_;
+    std::vector<AsyncListener*> listeners_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<bool> sleeping_{false};
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+    std::thread thread_; // Last, so everything above exists before it starts
+};
+
+// Forwards events to `target` on `worker`'s thread
+class AsyncListener : public EventListener {
+public:
+    // `capacity` events can wait for the worker before events are dropped
+    AsyncListener(EventListener& target, ListenerWorker& worker, size_t capacity = 1024)
+        : target_(target), worker_(worker), inbox_(capacity) {
+        worker_.attach(this);
+    }
+
+    // Events not delivered yet are dropped; waitUntilIdle() first to deliver them
+    ~AsyncListener() override {
+        worker_.detach(this);
+    }
+
+    // Called on the queue's thread; never waits for the worker
+    void onEvent(std::shared_ptr<Event> event) override {
+        Handoff handoff{std::move(event), std::chrono::steady_clock::now()};
+        lag_.fetch_add(1); // Before the push, so the worker never takes it below zero
+        if (!inbox_.tryPush(std::move(handoff))) {
+            lag_.fetch_sub(1);
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        worker_.notify();
+    }
+
+    // Events handed over and not delivered yet
+    size_t lag() const { return lag_.load(); }
+
+    // Events dropped because the worker had fallen `capacity` events behind
+    size_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    size_t delivered() const { return delivered_.load(std::memory_order_relaxed); }
+
+    // The longest any event has waited between onEvent() and the real listener
+    std::chrono::nanoseconds maxLatency() const {
+        return std::chrono::nanoseconds(maxLatency_.load(std::memory_order_relaxed));
+    }
+
+    // Waits until the worker has delivered everything handed over so far
+    void waitUntilIdle() const {
+        while (lag() > 0) {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    friend class ListenerWorker;
+
+    struct Handoff {
+        std::shared_ptr<Event> event;
+        std::chrono::steady_clock::time_point handedOver;
+    };
+
+    // Worker thread. Delivers up to `limit` events and returns how many.
+    size_t deliver(size_t limit) {
+        Handoff handoff;
+        size_t count = 0;
+        while (count < limit && inbox_.tryPop(handoff)) {
+            auto waited = std::chrono::steady_clock::now() - handoff.handedOver;
+            std::int64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count();
+            if (nanoseconds > maxLatency_.load(std::memory_order_relaxed)) {
+                maxLatency_.store(nanoseconds, std::memory_order_relaxed);
+            }
+            handoff.event->process(&target_);
+            handoff.event.reset();
+            delivered_.fetch_add(1, std::memory_order_relaxed);
+            lag_.fetch_sub(1);
+            ++count;
+        }
+        return count;
+    }
+
+    EventListener& target_;
+    ListenerWorker& worker_;
+    SpscRing<Handoff> inbox_; // Queue's thread -> worker thread
+    std::atomic<size_t> lag_{0};
+    std::atomic<size_t> dropped_{0};
+    std::atomic<size_t> delivered_{0};
+    std::atomic<std::int64_t> maxLatency_{0}; // Nanoseconds, only written by the worker
+};
+
+inline void ListenerWorker::run() {
+    for (;;) {
+        bool stopping = stopping_;
+        size_t delivered = 0;
+        {
+            // A batch per listener per pass, so one busy listener cannot starve the rest
+            std::lock_guard<std::mutex> lock(listenersMutex_);
+            for (AsyncListener* listener : listeners_) {
+                delivered += listener->deliver(eventBatchSize);
+            }
+        }
+        if (delivered > 0) {
+            continue;
+        }
+        if (stopping) {
+            return;
+        }
+
+        // Nothing to do: sleep until an AsyncListener hands something over. The
+        // timeout covers a handover that happens between the check and the wait.
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        sleeping_ = true;
+        bool idle = true;
+        {
+            std::lock_guard<std::mutex> listenersLock(listenersMutex_);
+            for (AsyncListener* listener : listeners_) {
+                if (listener->lag() > 0) idle = false;
+            }
+        }
+        if (idle && !stopping_) {
+            wake_.wait_for(lock, std::chrono::milliseconds(1));
+        }
+        sleeping_ = false;
+    }
+}
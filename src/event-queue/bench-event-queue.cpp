@@ -0,0 +1,830 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "event-queue.hpp"
+#include "async-listener.hpp"
+#include "concurrent-event-queue.hpp"
+#include "event-journal.hpp"
+#include "inline-event-queue.hpp"
+#include "scheduled-event-queue.hpp"
+#include "typed-event-queue.hpp"
+#include "allocation-counter.hpp"
+
+// Benchmarks for the event queues. Pass an event count as the first argument
+// to override the default.
+
+namespace {
+
+std::uint64_t nowNanoseconds() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// What producers post in the contention benchmark
+struct TimedEvent {
+    std::uint64_t sentAt;
+};
+
+// The obvious alternative to a lock-free ring: RingBufferEventQueue's ring
+// behind a mutex
+template <typename T>
+class MutexRing {
+public:
+    explicit MutexRing(size_t capacity) : slots_(capacity + 1) {}
+
+    bool tryPush(T&& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if ((head_ + 1) % slots_.size() == tail_) {
+            return false;
+        }
+        slots_[head_] = std::move(value);
+        head_ = (head_ + 1) % slots_.size();
+        return true;
+    }
+
+    bool tryPop(T& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tail_ == head_) {
+            return false;
+        }
+        out = std::move(slots_[tail_]);
+        tail_ = (tail_ + 1) % slots_.size();
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<T> slots_;
+    size_t head_ = 0;
+    size_t tail_ = 0;
+};
+
+// Nanoseconds at the given fraction of the sorted samples
+double percentile(std::vector<std::uint64_t>& samples, double fraction) {
+    size_t index = std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return static_cast<double>(samples[index]);
+}
+
+// `producers` threads post `events` TimedEvents in total while the calling
+// thread drains them, recording how long each one waited in the ring
+template <typename Ring>
+void runContention(const char* name, size_t producers, size_t events, size_t capacity) {
+    Ring ring(capacity);
+    size_t perProducer = std::max<size_t>(1, events / producers); // At least one, so there are latencies
+    size_t total = perProducer * producers;
+    std::vector<std::uint64_t> latencies;
+    latencies.reserve(total);
+
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&] {
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            for (size_t i = 0; i < perProducer; ++i) {
+                TimedEvent event{nowNanoseconds()};
+                while (!ring.tryPush(std::move(event))) std::this_thread::yield();
+            }
+        });
+    }
+
+    std::uint64_t start = nowNanoseconds();
+    go.store(true, std::memory_order_release);
+    TimedEvent event;
+    while (latencies.size() < total) {
+        if (ring.tryPop(event)) {
+            latencies.push_back(nowNanoseconds() - event.sentAt);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    double seconds = static_cast<double>(nowNanoseconds() - start) / 1e9;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::cout << name << " " << producers << " producer" << (producers == 1 ? ": " : "s: ")
+              << total / seconds / 1e6 << " Mevents/s, latency p50 " << percentile(latencies, 0.5)
+              << " ns, p99 " << percentile(latencies, 0.99) << " ns, p99.9 " << percentile(latencies, 0.999)
+              << " ns" << std::endl;
+}
+
+void benchContention(size_t events) {
+    std::cout << "== Producer contention (capacity 1024) ==" << std::endl;
+    runContention<SpscRing<TimedEvent>>("spsc", 1, events, 1024);
+    for (size_t producers : {1, 2, 4, 8, 16}) {
+        runContention<MpscRing<TimedEvent>>("mpsc", producers, events, 1024);
+        runContention<MutexRing<TimedEvent>>("mutex", producers, events, 1024);
+    }
+    std::cout << std::endl;
+}
+
+template <typename Fn>
+double secondsFor(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+// Texts long enough that std::string has to allocate for them
+const char* const benchmarkMessages[] = {
+    "Player 1 picked up the Sword of a Thousand Truths", "Enemy wave 3 has spawned at the north gate",
+    "Achievement unlocked: defeat 100 skeletons", "Error: texture atlas page 4 failed to stream in",
+    "Player 2 has joined the party as a level 12 mage", "Quest updated: return the amulet to the elder",
+    "Boss phase two begins, the arena floor is collapsing", "Checkpoint reached, progress has been saved"};
+const size_t benchmarkMessageCount = sizeof(benchmarkMessages) / sizeof(benchmarkMessages[0]);
+
+// Two listeners, like the ConsoleLogger and AlertSystem pair, without the I/O
+class CountingListener : public EventListener {
+public:
+    void onEvent(std::shared_ptr<Event> event) override {
+        if (auto messageEvent = dynamic_cast<MessageEvent*>(event.get())) {
+            characters += messageEvent->getMessage().size();
+        }
+    }
+    size_t characters = 0;
+};
+
+class InlineCountingListener : public InlineEventListener {
+public:
+    void onEvent(const InlineEvent& event) override {
+        if (event.type == MESSAGE_EVENT) {
+            characters += event.as<MessagePayload>().text.length;
+        }
+    }
+    size_t characters = 0;
+};
+
+// Sends `events` messages in frames of `frameSize`, processing the queue at
+// the end of every frame, and reports the cost per event
+template <typename Frame>
+void reportPerEvent(const char* name, size_t events, size_t frameSize, Frame&& frame, const size_t& characters) {
+    frame(0); // Warm-up: lets arenas, interners and rings reach their steady-state size
+    size_t frames = std::max<size_t>(1, events / frameSize);
+    size_t allocationsBefore = allocationCount.load();
+    double seconds = secondsFor([&] {
+        for (size_t f = 1; f <= frames; ++f) frame(f);
+    });
+    size_t allocations = allocationCount.load() - allocationsBefore;
+    double total = static_cast<double>(frames * frameSize);
+    std::cout << name << ": " << seconds / total * 1e9 << " ns/event, "
+              << static_cast<double>(allocations) / total << " allocations/event (" << characters
+              << " characters seen)" << std::endl;
+}
+
+void benchValueEvents(size_t events) {
+    std::cout << "== shared_ptr<Event> vs InlineEvent (enqueue + dispatch to 2 listeners) ==" << std::endl;
+    const size_t frameSize = 512;
+
+    {
+        RingBufferEventQueue queue(frameSize + 1);
+        CountingListener logger, alerter;
+        queue.addListener(&logger);
+        queue.addListener(&alerter);
+        reportPerEvent("shared_ptr<MessageEvent>", events, frameSize, [&](size_t f) {
+            for (size_t i = 0; i < frameSize; ++i) {
+                // What EventGenerator::generateMessage() does, minus the printing
+                std::string message = benchmarkMessages[(f + i) % benchmarkMessageCount];
+                queue.enqueue(std::make_shared<MessageEvent>(message));
+            }
+            queue.processEvents();
+        }, logger.characters);
+    }
+
+    {
+        InlineEventQueue queue(frameSize);
+        InlineCountingListener logger, alerter;
+        queue.addListener(&logger);
+        queue.addListener(&alerter);
+        StringInterner interner;
+        reportPerEvent("InlineEvent, interned text", events, frameSize, [&](size_t f) {
+            for (size_t i = 0; i < frameSize; ++i) {
+                const char* message = benchmarkMessages[(f + i) % benchmarkMessageCount];
+                queue.enqueue(MESSAGE_EVENT, 0, MessagePayload{interner.intern(message, std::strlen(message))});
+            }
+            queue.processEvents();
+        }, logger.characters);
+    }
+
+    {
+        InlineEventQueue queue(frameSize);
+        InlineCountingListener logger, alerter;
+        queue.addListener(&logger);
+        queue.addListener(&alerter);
+        FrameArena frameText;
+        reportPerEvent("InlineEvent, frame arena text", events, frameSize, [&](size_t f) {
+            for (size_t i = 0; i < frameSize; ++i) {
+                const char* message = benchmarkMessages[(f + i) % benchmarkMessageCount];
+                queue.enqueue(MESSAGE_EVENT, 0, MessagePayload{frameText.copy(message, std::strlen(message))});
+            }
+            queue.processEvents();
+            frameText.reset();
+        }, logger.characters);
+    }
+    std::cout << std::endl;
+}
+
+// Event classes for the dispatch benchmark: NumberedEvent<0> .. NumberedEvent<49>
+const int dispatchEventTypes = 50;
+const int dispatchListeners = 200;
+const int subscribedEventTypes = 40; // Types 40..49 have no listeners
+
+template <int N>
+class NumberedEvent : public Event, public std::enable_shared_from_this<NumberedEvent<N>> {
+public:
+    explicit NumberedEvent(int value) : value_(value) {}
+    void process(EventListener* listener) override { listener->onEvent(this->shared_from_this()); }
+    int value() const { return value_; }
+private:
+    int value_;
+};
+
+// Broadcast listener: asks every event whether it is the type it wants
+template <int N>
+class CastingListener : public EventListener {
+public:
+    void onEvent(std::shared_ptr<Event> event) override {
+        if (auto numbered = dynamic_cast<NumberedEvent<N>*>(event.get())) {
+            sum += numbered->value();
+        }
+    }
+    long sum = 0;
+};
+
+template <int N>
+class TypedListener : public Subscriber<NumberedEvent<N>> {
+public:
+    void onEvent(const NumberedEvent<N>& event) override { sum += event.value(); }
+    long sum = 0;
+};
+
+class InlineTypeListener : public InlineEventListener {
+public:
+    explicit InlineTypeListener(std::uint32_t type) : type_(type) {}
+    void onEvent(const InlineEvent& event) override {
+        if (event.type == type_) sum += event.as<int>();
+    }
+    long sum = 0;
+private:
+    std::uint32_t type_;
+};
+
+// Everything one dispatch benchmark needs for event class N
+struct NumberedEventOps {
+    std::shared_ptr<Event> (*make)(int value);
+    void (*enqueueTyped)(TypedEventQueue& queue, int value);
+    EventListener* (*makeCasting)(std::vector<std::shared_ptr<void>>& owner, long*& sum);
+    void (*subscribeTyped)(TypedEventQueue& queue, std::vector<std::shared_ptr<void>>& owner, long*& sum);
+};
+
+template <int N>
+NumberedEventOps numberedEventOps() {
+    return {
+        [](int value) -> std::shared_ptr<Event> { return std::make_shared<NumberedEvent<N>>(value); },
+        [](TypedEventQueue& queue, int value) { queue.enqueue(std::make_shared<NumberedEvent<N>>(value)); },
+        [](std::vector<std::shared_ptr<void>>& owner, long*& sum) -> EventListener* {
+            auto listener = std::make_shared<CastingListener<N>>();
+            owner.push_back(listener);
+            sum = &listener->sum;
+            return listener.get();
+        },
+        [](TypedEventQueue& queue, std::vector<std::shared_ptr<void>>& owner, long*& sum) {
+            auto listener = std::make_shared<TypedListener<N>>();
+            owner.push_back(listener);
+            sum = &listener->sum;
+            queue.subscribe<NumberedEvent<N>>(listener.get());
+        }};
+}
+
+template <int... N>
+std::vector<NumberedEventOps> allNumberedEventOps(std::integer_sequence<int, N...>) {
+    return {numberedEventOps<N>()...};
+}
+
+long totalOf(const std::vector<long*>& sums) {
+    long total = 0;
+    for (long* sum : sums) total += *sum;
+    return total;
+}
+
+void reportDispatch(const char* name, size_t events, double seconds, long total, long expected) {
+    std::cout << name << ": " << seconds / static_cast<double>(events) * 1e9 << " ns/event"
+              << (total == expected ? "" : " [RESULTS DIFFER]") << std::endl;
+}
+
+void benchDispatch(size_t events) {
+    std::cout << "== Broadcast vs per-type dispatch (" << dispatchEventTypes << " event types, "
+              << dispatchListeners << " listeners) ==" << std::endl;
+    std::vector<NumberedEventOps> ops = allNumberedEventOps(std::make_integer_sequence<int, dispatchEventTypes>());
+    const size_t batch = 4096;
+    size_t batches = std::max<size_t>(1, events / batch);
+    size_t total = batches * batch;
+
+    // What all listeners together should have added up
+    long expected = 0;
+    for (size_t i = 0; i < batch; ++i) {
+        if (static_cast<int>(i % dispatchEventTypes) < subscribedEventTypes) {
+            expected += static_cast<long>(i) * (dispatchListeners / subscribedEventTypes);
+        }
+    }
+    expected *= static_cast<long>(batches);
+
+    {
+        RingBufferEventQueue queue(batch + 1);
+        std::vector<std::shared_ptr<void>> owner;
+        std::vector<long*> sums(dispatchListeners);
+        for (int l = 0; l < dispatchListeners; ++l) {
+            queue.addListener(ops[l % subscribedEventTypes].makeCasting(owner, sums[l]));
+        }
+        double seconds = 0;
+        for (size_t b = 0; b < batches; ++b) {
+            for (size_t i = 0; i < batch; ++i) queue.enqueue(ops[i % dispatchEventTypes].make(static_cast<int>(i)));
+            seconds += secondsFor([&] { queue.processEvents(); });
+        }
+        reportDispatch("broadcast + dynamic_cast", total, seconds, totalOf(sums), expected);
+    }
+
+    {
+        TypedEventQueue queue(batch);
+        std::vector<std::shared_ptr<void>> owner;
+        std::vector<long*> sums(dispatchListeners);
+        for (int l = 0; l < dispatchListeners; ++l) {
+            ops[l % subscribedEventTypes].subscribeTyped(queue, owner, sums[l]);
+        }
+        double seconds = 0;
+        for (size_t b = 0; b < batches; ++b) {
+            for (size_t i = 0; i < batch; ++i) ops[i % dispatchEventTypes].enqueueTyped(queue, static_cast<int>(i));
+            seconds += secondsFor([&] { queue.processEvents(); });
+        }
+        reportDispatch("TypedEventQueue", total, seconds, totalOf(sums), expected);
+    }
+
+    for (bool subscribe : {false, true}) {
+        InlineEventQueue queue(batch);
+        std::vector<InlineTypeListener> listeners;
+        for (int l = 0; l < dispatchListeners; ++l) {
+            listeners.emplace_back(static_cast<std::uint32_t>(l % subscribedEventTypes));
+        }
+        std::vector<long*> sums;
+        for (InlineTypeListener& listener : listeners) {
+            if (subscribe) {
+                queue.subscribe(static_cast<std::uint32_t>(&listener - listeners.data()) % subscribedEventTypes,
+                                &listener);
+            } else {
+                queue.addListener(&listener);
+            }
+            sums.push_back(&listener.sum);
+        }
+        double seconds = 0;
+        for (size_t b = 0; b < batches; ++b) {
+            for (size_t i = 0; i < batch; ++i) {
+                queue.enqueue(static_cast<std::uint32_t>(i % dispatchEventTypes), 0, static_cast<int>(i));
+            }
+            seconds += secondsFor([&] { queue.processEvents(); });
+        }
+        reportDispatch(subscribe ? "InlineEventQueue, subscribe()" : "InlineEventQueue, broadcast", total, seconds,
+                       totalOf(sums), expected);
+    }
+    std::cout << std::endl;
+}
+
+// Adds up the x of every position it sees, one virtual call per event
+class PositionListener : public InlineEventListener {
+public:
+    void onEvent(const InlineEvent& event) override {
+        if (event.type == POSITION_CHANGED_EVENT) sum += event.as<PositionPayload>().x;
+    }
+
+    double sum = 0;
+};
+
+// The same, one virtual call per run of same-type events
+class PositionRunListener : public PositionListener {
+public:
+    void onEvents(const InlineEvent* events, size_t count) override {
+        if (events->type != POSITION_CHANGED_EVENT) return;
+        for (size_t i = 0; i < count; ++i) sum += events[i].as<PositionPayload>().x;
+    }
+};
+
+// Stands in for a listener with real work to do, a few nanoseconds per step
+class SlowListener : public InlineEventListener {
+public:
+    explicit SlowListener(int steps = 300) : steps_(steps) {}
+
+    void onEvent(const InlineEvent& event) override {
+        for (int i = 0; i < steps_; ++i) work = work * 31 + event.target;
+    }
+
+    volatile std::uint32_t work = 0;
+
+private:
+    int steps_;
+};
+
+void benchBudget(size_t events) {
+    std::cout << "== Per-event vs per-run dispatch (8 listeners, runs of 31 positions) ==" << std::endl;
+    const size_t batch = 4096;
+    size_t batches = std::max<size_t>(1, events / batch);
+    for (bool runs : {false, true}) {
+        InlineEventQueue queue(batch);
+        std::vector<PositionListener> perEvent(8);
+        std::vector<PositionRunListener> perRun(8);
+        for (size_t l = 0; l < 8; ++l) {
+            queue.addListener(runs ? static_cast<InlineEventListener*>(&perRun[l]) : &perEvent[l]);
+        }
+        double seconds = 0;
+        for (size_t b = 0; b < batches; ++b) {
+            for (size_t i = 0; i < batch; ++i) {
+                if (i % 32 == 31) {
+                    queue.enqueue(PLAY_SOUND_EVENT, 0, SoundPayload{1, 1.0f});
+                } else {
+                    queue.enqueue(POSITION_CHANGED_EVENT, 0, PositionPayload{1.0f, 0.0f, 0.0f});
+                }
+            }
+            seconds += secondsFor([&] { queue.processEvents(); });
+        }
+        double sum = runs ? perRun[0].sum : perEvent[0].sum;
+        std::cout << (runs ? "onEvents() per run" : "onEvent() per event") << ": "
+                  << seconds / static_cast<double>(batches * batch) * 1e9 << " ns/event (checksum " << sum << ")"
+                  << std::endl;
+    }
+
+    const size_t burst = std::min<size_t>(events, 20000);
+    const auto frameBudget = std::chrono::milliseconds(2);
+    std::cout << "== Burst of " << burst << " events to a slow listener, with and without a 2 ms budget ==" << std::endl;
+    for (bool budgeted : {false, true}) {
+        InlineEventQueue queue(burst);
+        SlowListener listener;
+        queue.addListener(&listener);
+        for (size_t i = 0; i < burst; ++i) {
+            queue.enqueue(PLAY_SOUND_EVENT, static_cast<std::uint32_t>(i), SoundPayload{1, 1.0f});
+        }
+        size_t frames = 0;
+        double longest = 0;
+        while (queue.size() > 0) {
+            double seconds = secondsFor([&] {
+                if (budgeted) {
+                    queue.processEvents(EventBudget::time(frameBudget));
+                } else {
+                    queue.processEvents();
+                }
+            });
+            longest = std::max(longest, seconds);
+            ++frames;
+        }
+        std::cout << (budgeted ? "2 ms budget" : "no budget") << ": " << frames << " frames, longest "
+                  << longest * 1e3 << " ms" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+// Bursty frames: every entity reports its position several times and asks for
+// the same footstep sound. Listeners either do nothing with an event or do
+// some work with it, to show what coalescing costs and what it saves.
+void benchCoalescing(size_t events) {
+    const std::uint32_t entities = 512;
+    const int updatesPerEntity = 6;
+    const size_t frameEvents = entities * updatesPerEntity * 2;
+    size_t frames = std::max<size_t>(1, events / frameEvents);
+    std::cout << "== Coalescing bursts (" << entities << " entities x " << updatesPerEntity
+              << " positions + sounds per frame, 4 listeners) ==" << std::endl;
+    for (int run = 0; run < 4; ++run) {
+        int steps = run < 2 ? 0 : 20;
+        bool coalesce = run % 2 == 1;
+        InlineEventQueue queue(frameEvents);
+        if (coalesce) {
+            queue.coalesce(POSITION_CHANGED_EVENT, keepLatest);
+            queue.coalesce(PLAY_SOUND_EVENT, keepFirst);
+        }
+        std::vector<SlowListener> listeners(4, SlowListener(steps));
+        for (SlowListener& listener : listeners) queue.addListener(&listener);
+        size_t dispatched = 0;
+        double seconds = secondsFor([&] {
+            for (size_t f = 0; f < frames; ++f) {
+                for (int u = 0; u < updatesPerEntity; ++u) {
+                    for (std::uint32_t entity = 0; entity < entities; ++entity) {
+                        queue.enqueue(POSITION_CHANGED_EVENT, entity, PositionPayload{static_cast<float>(u), 0, 0});
+                        queue.enqueue(PLAY_SOUND_EVENT, entity, SoundPayload{3, 1.0f});
+                    }
+                }
+                dispatched += queue.processEvents(EventBudget());
+            }
+        });
+        double total = static_cast<double>(frames * frameEvents);
+        std::cout << (steps ? "busy listeners, " : "idle listeners, ") << (coalesce ? "coalescing" : "every event")
+                  << ": " << seconds / static_cast<double>(frames) * 1e6 << " us/frame, "
+                  << static_cast<double>(dispatched) / total * 100 << "% of events dispatched, "
+                  << queue.coalesced() << " saved" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+// Schedules `timers` timers due within the next million ticks, then advances
+// through all of them. The checksum mixes each timer with the tick it fired
+// on, so both structures must fire everything on the right tick to agree.
+template <typename Schedule, typename FireAll>
+void runTimers(const char* name, size_t timers, Schedule&& schedule, FireAll&& fireAll) {
+    const std::uint64_t horizon = 1 << 20;
+    std::uint64_t random = 12345;
+    double scheduleSeconds = secondsFor([&] {
+        for (size_t i = 0; i < timers; ++i) {
+            random = random * 6364136223846793005ull + 1442695040888963407ull;
+            schedule(static_cast<std::uint32_t>(i), 1 + (random >> 33) % horizon);
+        }
+    });
+    std::uint64_t checksum = 0;
+    double fireSeconds = secondsFor([&] { checksum = fireAll(horizon); });
+    std::cout << name << " with " << timers << " timers: " << scheduleSeconds / static_cast<double>(timers) * 1e9
+              << " ns/schedule, " << fireSeconds / static_cast<double>(timers) * 1e9 << " ns/fire (checksum "
+              << checksum << ")" << std::endl;
+}
+
+void benchTimers(size_t events) {
+    std::cout << "== Timing wheel vs sorted container (timers due within 2^20 ticks) ==" << std::endl;
+    for (size_t timers : {std::max<size_t>(1, events / 100), events, events * 4}) {
+        {
+            TimingWheel<std::uint32_t> wheel;
+            runTimers("TimingWheel", timers, [&](std::uint32_t id, std::uint64_t due) { wheel.schedule(id, due); },
+                      [&](std::uint64_t horizon) {
+                          std::uint64_t checksum = 0;
+                          for (std::uint64_t tick = 1; tick <= horizon; ++tick) {
+                              wheel.advanceTo(tick, [&](std::uint32_t id) { checksum += id ^ (tick << 20); });
+                          }
+                          return checksum;
+                      });
+        }
+        {
+            std::multimap<std::uint64_t, std::uint32_t> sorted;
+            runTimers("std::multimap", timers, [&](std::uint32_t id, std::uint64_t due) { sorted.emplace(due, id); },
+                      [&](std::uint64_t horizon) {
+                          std::uint64_t checksum = 0;
+                          for (std::uint64_t tick = 1; tick <= horizon; ++tick) {
+                              while (!sorted.empty() && sorted.begin()->first <= tick) {
+                                  checksum += sorted.begin()->second ^ (tick << 20);
+                                  sorted.erase(sorted.begin());
+                              }
+                          }
+                          return checksum;
+                      });
+        }
+    }
+    std::cout << std::endl;
+}
+
+// Recording cost on the game thread, then replay speed. The journal is
+// written to bench-event-journal.bin in the working directory and deleted
+// afterwards.
+void benchJournal(size_t events) {
+    std::cout << "== Event journal (enqueue + dispatch to 2 listeners, one of them the journal) ==" << std::endl;
+    const size_t frameSize = 512;
+    const char* path = "bench-event-journal.bin";
+    EventCodecs codecs;
+    codecs.add<MessageEvent>(1, encodeMessageEvent, decodeMessageEvent);
+
+    for (bool record : {false, true}) {
+        RingBufferEventQueue queue(frameSize + 1);
+        CountingListener logger;
+        queue.addListener(&logger);
+        std::unique_ptr<EventJournal> journal;
+        CountingListener alerter;
+        if (record) {
+            journal.reset(new EventJournal(path, codecs));
+            queue.addListener(journal.get());
+        } else {
+            queue.addListener(&alerter);
+        }
+        reportPerEvent(record ? "with EventJournal" : "without journal", events, frameSize, [&](size_t f) {
+            for (size_t i = 0; i < frameSize; ++i) {
+                queue.enqueue(std::make_shared<MessageEvent>(benchmarkMessages[(f + i) % benchmarkMessageCount]));
+            }
+            queue.processEvents();
+        }, logger.characters);
+        if (journal) {
+            std::cout << "    " << journal->recorded() << " events recorded, " << journal->stalls()
+                      << " times the writer was behind" << std::endl;
+        }
+    }
+
+    {
+        EventJournalReplay replay(path, codecs);
+        CountingListener counter;
+        replay.addListener(&counter);
+        size_t replayed = 0;
+        double seconds = secondsFor([&] { replayed = replay.run(); });
+        double recorded = std::chrono::duration<double>(replay.recordedDuration()).count();
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        std::cout << "replay: " << static_cast<double>(replayed) / seconds / 1e6 << " M events/sec, "
+                  << recorded / seconds << "x faster than recorded, "
+                  << static_cast<double>(file.tellg()) / static_cast<double>(replayed) << " bytes/event on disk"
+                  << std::endl;
+    }
+    std::remove(path);
+    std::cout << std::endl;
+}
+
+// A listener with a microsecond or so of work per event
+class BusyListener : public EventListener {
+public:
+    void onEvent(std::shared_ptr<Event>) override {
+        for (int i = 0; i < 400; ++i) work = work * 31 + static_cast<std::uint32_t>(i);
+    }
+
+    volatile std::uint32_t work = 0;
+};
+
+// Time spent on the queue's thread with a slow listener inline or on a worker.
+// Frames are 1 ms apart, which gives the worker time to run even on one core.
+void benchAsyncListeners(size_t events) {
+    std::cout << "== Slow listener inline vs on a ListenerWorker (plus 3 fast listeners) ==" << std::endl;
+    const size_t frameSize = 512;
+    size_t frames = std::max<size_t>(1, events / 4 / frameSize);
+    for (bool async : {false, true}) {
+        RingBufferEventQueue queue(frameSize + 1);
+        CountingListener fast[3];
+        for (CountingListener& listener : fast) queue.addListener(&listener);
+        BusyListener slow;
+        ListenerWorker worker;
+        AsyncListener asyncSlow(slow, worker, 4 * frameSize);
+        queue.addListener(async ? static_cast<EventListener*>(&asyncSlow) : &slow);
+        double longestFrame = 0;
+        double seconds = 0;
+        for (size_t f = 0; f < frames; ++f) {
+            for (size_t i = 0; i < frameSize; ++i) {
+                queue.enqueue(std::make_shared<MessageEvent>(benchmarkMessages[(f + i) % benchmarkMessageCount]));
+            }
+            double frame = secondsFor([&] { queue.processEvents(); });
+            longestFrame = std::max(longestFrame, frame);
+            seconds += frame;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1)); // The rest of the frame, e.g. waiting for vsync
+        }
+        asyncSlow.waitUntilIdle();
+        std::cout << (async ? "on a worker" : "inline") << ": "
+                  << seconds / static_cast<double>(frames * frameSize) * 1e9 << " ns/event on the queue's thread, "
+                  << "longest frame " << longestFrame * 1e3 << " ms";
+        if (async) {
+            std::cout << ", worker delivered " << asyncSlow.delivered() << ", dropped " << asyncSlow.dropped()
+                      << ", longest wait " << std::chrono::duration<double, std::milli>(asyncSlow.maxLatency()).count()
+                      << " ms";
+        }
+        std::cout << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+// RingBufferEventQueue across capacities, listener counts and payload sizes
+// ------------------------------------------------------------------------
+// For every combination the suite measures:
+// - enqueue: ns per enqueue() of an already built event
+// - dispatch: ns per event per listener inside processEvents(), freeing the
+//   event after the last listener included
+// - latency: enqueue() to the last listener, p50/p99/p999, in a separate pass
+//   so reading the clock does not inflate the costs above
+// - allocations per event, building the event included
+// The results also go to a JSON file for tracking regressions.
+
+// A MessageEvent that remembers when it was enqueued
+class StampedMessageEvent : public MessageEvent {
+public:
+    using MessageEvent::MessageEvent;
+    std::uint64_t enqueuedAt = 0;
+};
+
+// Reads the payload like a real listener would. The last listener of the
+// latency pass also records how long the event took to reach it.
+class SuiteListener : public EventListener {
+public:
+    void onEvent(std::shared_ptr<Event> event) override {
+        const StampedMessageEvent& message = static_cast<const StampedMessageEvent&>(*event);
+        characters += message.getMessage().size();
+        if (latencies) latencies->push_back(nowNanoseconds() - message.enqueuedAt);
+    }
+
+    size_t characters = 0;
+    std::vector<std::uint64_t>* latencies = nullptr;
+};
+
+struct SuiteResult {
+    size_t capacity, listeners, payloadBytes, events;
+    double enqueueNs, dispatchNsPerListener, p50, p99, p999, allocationsPerEvent;
+};
+
+SuiteResult runSuiteCase(size_t capacity, size_t listenerCount, size_t payloadBytes, size_t events) {
+    SuiteResult result{capacity, listenerCount, payloadBytes, 0, 0, 0, 0, 0, 0, 0};
+    const size_t frameSize = capacity - 1; // What the ring holds
+    const size_t frames = std::max<size_t>(1, events / frameSize);
+    const std::string payload(payloadBytes, 'x');
+    RingBufferEventQueue queue(capacity);
+    std::vector<SuiteListener> listeners(listenerCount);
+    for (SuiteListener& listener : listeners) queue.addListener(&listener);
+    std::vector<std::shared_ptr<StampedMessageEvent>> frame;
+    frame.reserve(frameSize);
+
+    double enqueueSeconds = 0, dispatchSeconds = 0;
+    size_t allocationsBefore = allocationCount.load();
+    for (size_t f = 0; f < frames; ++f) {
+        for (size_t i = 0; i < frameSize; ++i) frame.push_back(std::make_shared<StampedMessageEvent>(payload));
+        enqueueSeconds += secondsFor([&] {
+            for (auto& event : frame) queue.enqueue(std::move(event));
+        });
+        frame.clear();
+        dispatchSeconds += secondsFor([&] { queue.processEvents(); });
+    }
+    double total = static_cast<double>(frames * frameSize);
+    result.events = frames * frameSize;
+    result.allocationsPerEvent = static_cast<double>(allocationCount.load() - allocationsBefore) / total;
+    result.enqueueNs = enqueueSeconds / total * 1e9;
+    result.dispatchNsPerListener = dispatchSeconds / total / static_cast<double>(listenerCount) * 1e9;
+
+    std::vector<std::uint64_t> latencies;
+    latencies.reserve(result.events);
+    listeners.back().latencies = &latencies;
+    for (size_t f = 0; f < frames; ++f) {
+        for (size_t i = 0; i < frameSize; ++i) frame.push_back(std::make_shared<StampedMessageEvent>(payload));
+        for (auto& event : frame) {
+            event->enqueuedAt = nowNanoseconds();
+            queue.enqueue(std::move(event));
+        }
+        frame.clear();
+        queue.processEvents();
+    }
+    result.p50 = percentile(latencies, 0.5);
+    result.p99 = percentile(latencies, 0.99);
+    result.p999 = percentile(latencies, 0.999);
+    return result;
+}
+
+void writeSuiteJson(std::ostream& out, size_t events, const std::vector<SuiteResult>& results) {
+    out << "{\n  \"benchmark\": \"RingBufferEventQueue\",\n  \"events\": " << events << ",\n  \"results\": [";
+    const char* separator = "\n";
+    for (const SuiteResult& r : results) {
+        out << separator << "    {\"capacity\": " << r.capacity << ", \"listeners\": " << r.listeners
+            << ", \"payloadBytes\": " << r.payloadBytes << ", \"events\": " << r.events
+            << ", \"enqueueNs\": " << r.enqueueNs << ", \"dispatchNsPerListener\": " << r.dispatchNsPerListener
+            << ", \"latencyNs\": {\"p50\": " << r.p50 << ", \"p99\": " << r.p99 << ", \"p999\": " << r.p999
+            << "}, \"allocationsPerEvent\": " << r.allocationsPerEvent << "}";
+        separator = ",\n";
+    }
+    out << "\n  ]\n}\n";
+}
+
+void benchSuite(size_t events, const char* jsonPath) {
+    std::cout << "== RingBufferEventQueue suite (enqueue ns, dispatch ns per listener, latency p50/p99/p999 ns, "
+                 "allocations per event) ==" << std::endl;
+    const size_t capacities[] = {16, 256, 4096};
+    const size_t listenerCounts[] = {1, 4, 16};
+    const size_t payloadSizes[] = {8, 64, 1024}; // Message bytes; 8 fits std::string's inline buffer
+    size_t eventsPerCase = std::max<size_t>(4096, events / 27);
+    std::vector<SuiteResult> results;
+    for (size_t capacity : capacities) {
+        for (size_t listeners : listenerCounts) {
+            for (size_t payload : payloadSizes) {
+                SuiteResult r = runSuiteCase(capacity, listeners, payload, eventsPerCase);
+                std::cout << "capacity " << r.capacity << ", " << r.listeners << " listeners, " << r.payloadBytes
+                          << " bytes: enqueue " << r.enqueueNs << ", dispatch " << r.dispatchNsPerListener
+                          << ", latency " << r.p50 << "/" << r.p99 << "/" << r.p999 << ", allocations "
+                          << r.allocationsPerEvent << std::endl;
+                results.push_back(r);
+            }
+        }
+    }
+    std::ofstream json(jsonPath);
+    writeSuiteJson(json, eventsPerCase, results);
+    if (!json) {
+        throw std::runtime_error(std::string("Could not write ") + jsonPath);
+    }
+    std::cout << "Results written to " << jsonPath << std::endl << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t events = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 1000000;
+    const char* jsonPath = argc > 2 ? argv[2] : "bench-event-queue.json";
+
+    benchContention(events);
+    benchValueEvents(events);
+    benchDispatch(events);
+    benchBudget(events);
+    benchCoalescing(events);
+    benchTimers(events);
+    benchJournal(events);
+    benchAsyncListeners(events);
+    benchSuite(events, jsonPath);
+
+    return 0;
+}
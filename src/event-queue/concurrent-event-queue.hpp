@@ -0,0 +1,197 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "event-queue.hpp"
+
+// Lock-free rings for posting events from other threads
+// -----------------------------------------------------
+// SpscRing: one producer thread, one consumer thread.
+// MpscRing: any number of producer threads, one consumer thread.
+//
+// Both round their capacity up to a power of two so wrapping an index is a
+// mask instead of `%`, and every slot is usable (RingBufferEventQueue loses
+// one to tell full from empty). Indices only ever increase; the slot is
+// `index & mask_`. Indices written by different threads are kept on separate
+// cache lines so producers and the consumer do not invalidate each other's
+// lines on every operation.
+
+const size_t cacheLineSize = 64;
+
+inline size_t roundUpToPowerOfTwo(size_t value) {
+    size_t power = 1;
+    while (power < value) power <<= 1;
+    return power;
+}
+
+// An index owned by one side of a ring, alone on its cache line together with
+// that side's cached copy of the other side's index. Padded on both sides, so
+// it never shares a line with whatever comes before or after it.
+struct PaddedIndex {
+    char before[cacheLineSize];
+    std::atomic<size_t> value{0};
+    size_t cachedOther = 0;
+    char after[cacheLineSize - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+};
+
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity)
+        : mask_(roundUpToPowerOfTwo(capacity < 2 ? 2 : capacity) - 1), slots_(mask_ + 1) {}
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Producer only. Moves from `value` only if there was room.
+    bool tryPush(T&& value) {
+        size_t head = head_.value.load(std::memory_order_relaxed);
+        if (head - head_.cachedOther > mask_) {
+            // Looks full: refresh our copy of the consumer's index
+            head_.cachedOther = tail_.value.load(std::memory_order_acquire);
+            if (head - head_.cachedOther > mask_) {
+                return false;
+            }
+        }
+        slots_[head & mask_] = std::move(value);
+        head_.value.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only
+    bool tryPop(T& out) {
+        size_t tail = tail_.value.load(std::memory_order_relaxed);
+        if (tail == tail_.cachedOther) {
+            tail_.cachedOther = head_.value.load(std::memory_order_acquire);
+            if (tail == tail_.cachedOther) {
+                return false;
+            }
+        }
+        out = std::move(slots_[tail & mask_]);
+        tail_.value.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    const size_t mask_;
+    std::vector<T> slots_;
+    PaddedIndex head_; // Next slot to write; cachedOther is the producer's view of tail_
+    PaddedIndex tail_; // Next slot to read; cachedOther is the consumer's view of head_
+};
+
+// Bounded multi-producer ring after Dmitry Vyukov's MPMC queue, simplified for
+// a single consumer. Each slot carries a sequence number that says whose turn
+// it is: producers claim a slot by advancing head_ with a CAS, and publish it
+// by bumping the slot's sequence, so the consumer never touches head_.
+//
+// Producers never wait for each other, but a producer that is descheduled
+// between claiming and publishing a slot holds up the consumer at that slot.
+template <typename T>
+class MpscRing {
+public:
+    explicit MpscRing(size_t capacity)
+        : mask_(roundUpToPowerOfTwo(capacity < 2 ? 2 : capacity) - 1), slots_(new Slot[mask_ + 1]) {
+        for (size_t i = 0; i <= mask_; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Any thread. Moves from `value` only if there was room.
+    bool tryPush(T&& value) {
+        size_t head = head_.value.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &slots_[head & mask_];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence - head);
+            if (difference == 0) {
+                // The slot is free for lap `head`: try to claim it
+                if (head_.value.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false; // The consumer has not freed this slot yet: full
+            } else {
+                head = head_.value.load(std::memory_order_relaxed); // Another producer got it
+            }
+        }
+        slot->value = std::move(value);
+        slot->sequence.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only
+    bool tryPop(T& out) {
+        Slot& slot = slots_[tail_ & mask_];
+        if (slot.sequence.load(std::memory_order_acquire) != tail_ + 1) {
+            return false; // Empty, or the producer has not finished writing it
+        }
+        out = std::move(slot.value);
+        slot.sequence.store(tail_ + mask_ + 1, std::memory_order_release); // Free for the next lap
+        ++tail_;
+        return true;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    const size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    PaddedIndex head_;  // Shared by all producers
+    char separator_[cacheLineSize];
+    size_t tail_ = 0;   // Only the consumer reads or writes it
+};
+
+// RingBufferEventQueue for events posted from other threads. Any thread the
+// ring allows may enqueue; addListener() and processEvents() belong to the one
+// consumer thread.
+template <typename Ring>
+class ConcurrentEventQueue {
+public:
+    explicit ConcurrentEventQueue(size_t capacity) : ring_(capacity) {}
+
+    size_t capacity() const { return ring_.capacity(); }
+
+    // Returns false instead of waiting when the queue is full
+    bool tryEnqueue(std::shared_ptr<Event> event) {
+        return ring_.tryPush(std::move(event));
+    }
+
+    // Waits for room when the queue is full
+    void enqueue(std::shared_ptr<Event> event) {
+        while (!ring_.tryPush(std::move(event))) {
+            std::this_thread::yield();
+        }
+    }
+
+    void addListener(EventListener* listener) {
+        listeners_.push_back(listener);
+    }
+
+    // Dispatches everything that has been published so far
+    void processEvents() {
+        std::shared_ptr<Event> event;
+        while (ring_.tryPop(event)) {
+            for (EventListener* listener : listeners_) {
+                event->process(listener);
+            }
+        }
+        event.reset();
+    }
+
+private:
+    Ring ring_;
+    std::vector<EventListener*> listeners_;
+};
+
+using SpscEventQueue = ConcurrentEventQueue<SpscRing<std::shared_ptr<Event>>>;
+using MpscEventQueue = ConcurrentEventQueue<MpscRing<std::shared_ptr<Event>>>;
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+#include "event-queue.hpp"
+#include "concurrent-event-queue.hpp"
+
+// Event journal
+// -------------
+// EventJournal is an EventListener that appends every event it receives to a
+// binary file. Added to a RingBufferEventQueue, it sees every event that
+// passes through processEvents(). EventJournalReplay reads the file back and
+// hands the events to listeners again, at the recorded pace or faster.
+//
+// File (little-endian, integers marked varint are LEB128):
+//   magic "EVJL", format version (u32)
+//   records until the end of the file:
+//     nanoseconds since the previous record (varint), codec ID (varint),
+//     payload length (varint), payload
+//
+// Events are turned into payloads by codecs registered per event class.
+// Writer and reader must register the same codec IDs.
+
+class EventCodecs {
+public:
+    using Encode = void (*)(const Event& event, std::string& out);
+    using Decode = std::shared_ptr<Event> (*)(const char* data, size_t length);
+
+    // encode() is only called with events of exactly class E
+    template <typename E>
+    void add(std::uint32_t id, Encode encode, Decode decode) {
+        byType_[std::type_index(typeid(E))] = {id, encode};
+        byId_[id] = decode;
+    }
+
+    // Returns false if no codec was registered for the event's class
+    bool encode(const Event& event, std::uint32_t& id, std::string& out) const {
+        auto found = byType_.find(std::type_index(typeid(event)));
+        if (found == byType_.end()) {
+            return false;
+        }
+        id = found->second.id;
+        found->second.encode(event, out);
+        return true;
+    }
+
+    std::shared_ptr<Event> decode(std::uint32_t id, const char* data, size_t length) const {
+        auto found = byId_.find(id);
+        if (found == byId_.end()) {
+            throw std::runtime_error("Event journal uses unknown codec " + std::to_string(id));
+        }
+        return found->second(data, length);
+    }
+
+private:
+    struct Encoder {
+        std::uint32_t id;
+        Encode encode;
+    };
+
+    std::unordered_map<std::type_index, Encoder> byType_;
+    std::unordered_map<std::uint32_t, Decode> byId_;
+};
+
+// Codec for MessageEvent: the payload is the message text
+inline void encodeMessageEvent(const Event& event, std::string& out) {
+    out += static_cast<const MessageEvent&>(event).getMessage();
+}
+
+inline std::shared_ptr<Event> decodeMessageEvent(const char* data, size_t length) {
+    return std::make_shared<MessageEvent>(std::string(data, length));
+}
+
+namespace event_journal {
+
+const std::uint32_t formatVersion = 1;
+
+inline void putVarint(std::vector<char>& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+inline std::uint64_t getVarint(const char*& at, const char* end) {
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (at == end) {
+            throw std::runtime_error("Corrupt event journal: truncated record");
+        }
+        unsigned char byte = static_cast<unsigned char>(*at++);
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Corrupt event journal: bad varint");
+}
+
+} // namespace event_journal
+
+// Records events without ever waiting for the disk. onEvent() encodes into an
+// in-memory buffer; full buffers go to a writer thread through an SpscRing and
+// come back empty through another, so after warm-up recording allocates
+// nothing. If the writer falls behind, the buffer keeps growing instead of
+// blocking, and stalls() counts how often that happened.
+class EventJournal : public EventListener {
+public:
+    // Throws std::runtime_error if the file cannot be created
+    EventJournal(const std::string& path, const EventCodecs& codecs, size_t bufferSize = 64 * 1024)
+        : codecs_(codecs), bufferSize_(bufferSize), out_(path, std::ios::binary | std::ios::trunc), filled_(8),
+          spare_(8), lastRecord_(std::chrono::steady_clock::now()) {
+        if (!out_) {
+            throw std::runtime_error("Could not create event journal: " + path);
+        }
+        current_.reserve(bufferSize_);
+        current_.insert(current_.end(), {'E', 'V', 'J', 'L'});
+        for (int i = 0; i < 4; ++i) {
+            current_.push_back(static_cast<char>(event_journal::formatVersion >> (8 * i)));
+        }
+        writer_ = std::thread([this] { writeLoop(); });
+    }
+
+    // Writes everything recorded so far and closes the file
+    ~EventJournal() override {
+        while (!current_.empty() && !filled_.tryPush(std::move(current_))) {
+            std::this_thread::yield(); // Shutting down: waiting is fine now
+        }
+        done_ = true;
+        writer_.join();
+    }
+
+    void onEvent(std::shared_ptr<Event> event) override {
+        payload_.clear();
+        std::uint32_t codec;
+        if (!codecs_.encode(*event, codec, payload_)) {
+            ++unrecorded_;
+            return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        auto sincePrevious = std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastRecord_).count();
+        lastRecord_ = now;
+        event_journal::putVarint(current_, static_cast<std::uint64_t>(sincePrevious));
+        event_journal::putVarint(current_, codec);
+        event_journal::putVarint(current_, payload_.size());
+        current_.insert(current_.end(), payload_.begin(), payload_.end());
+        ++recorded_;
+        if (current_.size() >= bufferSize_) {
+            flush();
+        }
+    }
+
+    // Hands what has been recorded so far to the writer thread
+    void flush() {
+        if (current_.empty()) {
+            return;
+        }
+        if (!filled_.tryPush(std::move(current_))) {
+            ++stalls_; // Writer is behind: keep filling this buffer
+            return;
+        }
+        current_.clear();
+        std::vector<char> spare;
+        if (spare_.tryPop(spare)) {
+            current_.swap(spare);
+        } else {
+            current_.reserve(bufferSize_);
+        }
+    }
+
+    size_t recorded() const { return recorded_; }     // Events written to the journal
+    size_t unrecorded() const { return unrecorded_; } // Events skipped for lack of a codec
+    size_t stalls() const { return stalls_; }         // Times flush() found the writer behind
+    bool failed() const { return failed_; }           // A write to the file failed
+
+private:
+    void writeLoop() {
+        std::vector<char> buffer;
+        for (;;) {
+            // Read first: done_ is only set after the last buffer was pushed
+            bool finishing = done_;
+            if (filled_.tryPop(buffer)) {
+                out_.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                if (!out_) {
+                    failed_ = true;
+                }
+                buffer.clear();
+                spare_.tryPush(std::move(buffer)); // Kept until the next pop if there are spares enough
+            } else if (finishing) {
+                break;
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        out_.flush();
+        if (!out_) {
+            failed_ = true;
+        }
+    }
+
+    const EventCodecs& codecs_;
+    size_t bufferSize_;
+    std::ofstream out_;                  // Only the writer thread touches it after construction
+    SpscRing<std::vector<char>> filled_; // Game thread -> writer thread
+    SpscRing<std::vector<char>> spare_;  // Writer thread -> game thread, emptied buffers
+    std::vector<char> current_;
+    std::string payload_;
+    std::chrono::steady_clock::time_point lastRecord_;
+    size_t recorded_ = 0;
+    size_t unrecorded_ = 0;
+    size_t stalls_ = 0;
+    std::atomic<bool> done_{false};
+    std::atomic<bool> failed_{false};
+    std::thread writer_;
+};
+
+// Plays a journal back to listeners. With speed 1 events arrive with the
+// recorded gaps between them, with speed 10 ten times sooner, and with speed 0
+// as fast as the listeners can take them, which makes a recorded session a
+// repeatable load test.
+class EventJournalReplay {
+public:
+    // Throws std::runtime_error if the file is missing or not a journal
+    EventJournalReplay(const std::string& path, const EventCodecs& codecs) : codecs_(codecs) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("Could not open event journal: " + path);
+        }
+        file_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        if (file_.size() < 8 || std::memcmp(file_.data(), "EVJL", 4) != 0) {
+            throw std::runtime_error("Not an event journal: " + path);
+        }
+        std::uint32_t version = 0;
+        for (int i = 0; i < 4; ++i) {
+            version |= static_cast<std::uint32_t>(static_cast<unsigned char>(file_[4 + i])) << (8 * i);
+        }
+        if (version != event_journal::formatVersion) {
+            throw std::runtime_error("Unsupported event journal version: " + path);
+        }
+    }
+
+    void addListener(EventListener* listener) {
+        listeners_.push_back(listener);
+    }
+
+    // Returns the number of events replayed. Throws std::runtime_error on a
+    // corrupt record or an unknown codec.
+    size_t run(double speed = 0) {
+        const char* at = file_.data() + 8;
+        const char* end = file_.data() + file_.size();
+        const auto start = std::chrono::steady_clock::now();
+        std::uint64_t recordedTime = 0;
+        size_t replayed = 0;
+        while (at != end) {
+            recordedTime += event_journal::getVarint(at, end);
+            std::uint32_t codec = static_cast<std::uint32_t>(event_journal::getVarint(at, end));
+            std::uint64_t length = event_journal::getVarint(at, end);
+            if (static_cast<std::uint64_t>(end - at) < length) {
+                throw std::runtime_error("Corrupt event journal: truncated payload");
+            }
+            std::shared_ptr<Event> event = codecs_.decode(codec, at, static_cast<size_t>(length));
+            at += length;
+            if (speed > 0) {
+                double due = static_cast<double>(recordedTime) / speed;
+                std::this_thread::sleep_until(start + std::chrono::nanoseconds(static_cast<std::int64_t>(due)));
+            }
+            for (EventListener* listener : listeners_) {
+                event->process(listener);
+            }
+            ++replayed;
+        }
+        recordedDuration_ = std::chrono::nanoseconds(recordedTime);
+        return replayed;
+    }
+
+    // Time from the journal being opened to its last event, known after run()
+    std::chrono::nanoseconds recordedDuration() const { return recordedDuration_; }
+
+private:
+    const EventCodecs& codecs_;
+    std::vector<char> file_;
+    std::vector<EventListener*> listeners_;
+    std::chrono::nanoseconds recordedDuration_{0};
+};
@@ -1,117 +1,117 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <string>
+#include <thread>
 #include <vector>
-#include <memory>
-#include <array>
-#include <cassert>
+#include "event-queue.hpp"
+#include "async-listener.hpp"
+#include "concurrent-event-queue.hpp"
+#include "event-journal.hpp"
+#include "inline-event-queue.hpp"
+#include "scheduled-event-queue.hpp"
+#include "typed-event-queue.hpp"
 
-// Forward declaration
-class EventListener;
-
-// Base class for events
-class Event /*: public std::enable_shared_from_this<Event>*/ {
-public:
-    virtual ~Event() = default;
-    virtual void process(EventListener* listener) = 0;
-};
-
-// Concrete example event: MessageEvent
-class MessageEvent : public Event, public std::enable_shared_from_this<MessageEvent> {
-public:
-    MessageEvent(std::string message) : message_(std::move(message)) {}
-    void process(EventListener* listener) override;
-    const std::string& getMessage() const { return message_; }
-private:
-    std::string message_;
-};
-
-// Interface for event listeners (observers)
-class EventListener {
-public:
-    virtual ~EventListener() = default;
-    virtual void onEvent(std::shared_ptr<Event> event) = 0;
-};
-
-// Implementation of MessageEvent's process method
-inline void MessageEvent::process(EventListener* listener) {
-    listener->onEvent(shared_from_this()); // Transfer ownership to the listener
-}
-
-// Concrete example listener: ConsoleLogger
-class ConsoleLogger : public EventListener {
+// Counts messages by their first word, e.g. the thread that sent them
+class MessageCounter : public EventListener {
 public:
     void onEvent(std::shared_ptr<Event> event) override {
         if (auto messageEvent = dynamic_cast<MessageEvent*>(event.get())) {
-            std::cout << "ConsoleLogger received: " << messageEvent->getMessage() << std::endl;
-        } else {
-            std::cout << "ConsoleLogger received an unknown event type." << std::endl;
+            const std::string& message = messageEvent->getMessage();
+            counts_[message.substr(0, message.find(' '))]++;
         }
-        // Ownership of the event is now with ConsoleLogger (though we don't need it after processing here)
     }
+    const std::map<std::string, int>& counts() const { return counts_; }
+private:
+    std::map<std::string, int> counts_;
 };
 
-// Concrete example listener: AlertSystem
-class AlertSystem : public EventListener {
+// Remembers the messages it received, in order
+class MessageRecorder : public EventListener {
 public:
     void onEvent(std::shared_ptr<Event> event) override {
         if (auto messageEvent = dynamic_cast<MessageEvent*>(event.get())) {
-            if (messageEvent->getMessage().find("error") != std::string::npos) {
-                std::cerr << "**ALERT SYSTEM**: Error detected: " << messageEvent->getMessage() << std::endl;
-            }
+            received_ += (received_.empty() ? "" : ", ") + messageEvent->getMessage();
         }
-        // Ownership of the event is now with AlertSystem
     }
+    std::string take() {
+        std::string received;
+        received.swap(received_);
+        return received;
+    }
+private:
+    std::string received_;
 };
 
-// Ring buffer based event queue
-class RingBufferEventQueue {
-public:
-    RingBufferEventQueue(size_t capacity) : capacity_(capacity), buffer_(capacity) {}
-
-    void enqueue(std::shared_ptr<Event> event) {
-        assert((head_ + 1) % capacity_ != tail_); // Check for overflow
-        buffer_[head_] = std::move(event);
-        head_ = (head_ + 1) % capacity_;
-    }
+// Coalescing key for the overflow example: messages about the same unit ("unit 3 ...") share a key
+std::uint64_t unitKey(const Event& event) {
+    const std::string& message = static_cast<const MessageEvent&>(event).getMessage();
+    return std::hash<std::string>()(message.substr(0, message.find(' ', 5)));
+}
 
-    void addListener(EventListener* listener) {
-        listeners_.push_back(listener);
-    }
+// An event nobody in this example subscribes to
+class ScoreEvent : public Event {
+public:
+    explicit ScoreEvent(int points) : points_(points) {}
+    void process(EventListener*) override {} // Only ever sent through a TypedEventQueue
+    int getPoints() const { return points_; }
+private:
+    int points_;
+};
 
-    void processEvents() {
-        while (tail_ != head_) {
-            std::shared_ptr<Event> event = std::move(buffer_[tail_]);
-            tail_ = (tail_ + 1) % capacity_;
-            notifyListeners(event);
+// ConsoleLogger for value-typed events
+class InlineConsoleLogger : public InlineEventListener {
+public:
+    void onEvent(const InlineEvent& event) override {
+        switch (event.type) {
+            case MESSAGE_EVENT:
+                std::cout << "InlineConsoleLogger received: " << event.as<MessagePayload>().text.str() << std::endl;
+                break;
+            case POSITION_CHANGED_EVENT: {
+                PositionPayload position = event.as<PositionPayload>();
+                std::cout << "InlineConsoleLogger received: entity " << event.target << " moved to ("
+                          << position.x << ", " << position.y << ", " << position.z << ")" << std::endl;
+                break;
+            }
+            case PLAY_SOUND_EVENT:
+                std::cout << "InlineConsoleLogger received: entity " << event.target << " plays sound "
+                          << event.as<SoundPayload>().soundId << std::endl;
+                break;
+            default:
+                std::cout << "InlineConsoleLogger received an unknown event type." << std::endl;
         }
     }
+};
 
-private:
-    void notifyListeners(std::shared_ptr<Event> event) {
-        for (EventListener* listener : listeners_) {
-            event->process(listener); // Transfer ownership to each listener temporarily
-        }
-        // After processing by all listeners, the original unique_ptr goes out of scope,
-        // but each listener *should* have moved ownership if they needed to keep the event.
+// A ConsoleLogger that takes 10 ms per event, like one writing to a slow terminal
+class SlowConsoleLogger : public ConsoleLogger {
+public:
+    void onEvent(std::shared_ptr<Event> event) override {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ConsoleLogger::onEvent(event);
     }
-
-    size_t capacity_;
-    std::vector<std::shared_ptr<Event>> buffer_; // Fixed size for simplicity
-    size_t head_ = 0;
-    size_t tail_ = 0;
-    std::vector<EventListener*> listeners_;
 };
 
-// Single writer class
-class EventGenerator {
+// Prints the runs of same-type events it is handed
+class InlineRunLogger : public InlineEventListener {
 public:
-    EventGenerator(RingBufferEventQueue& queue) : eventQueue_(queue) {}
+    void onEvent(const InlineEvent& event) override {
+        onEvents(&event, 1);
+    }
 
-    void generateMessage(std::string message) {
-        std::cout << "EventGenerator sending: " << message << std::endl;
-        eventQueue_.enqueue(std::make_shared<MessageEvent>(message));
+    void onEvents(const InlineEvent* events, size_t count) override {
+        const char* names[] = {"message", "position", "sound"};
+        std::cout << "    " << count << " x " << (events->type < 3 ? names[events->type] : "unknown")
+                  << " for entities";
+        for (size_t i = 0; i < count; ++i) {
+            std::cout << " " << events[i].target;
+        }
+        std::cout << std::endl;
     }
-private:
-    RingBufferEventQueue& eventQueue_;
 };
 
 int main() {
@@ -142,6 +142,201 @@ int main() {
     eventQueue.processEvents();
     std::cout << "**Events Processed**" << std::endl;
 
+    // Post events from several threads at once to a lock-free multi-producer queue
+    MpscEventQueue sharedQueue(64);
+    MessageCounter counter;
+    sharedQueue.addListener(&counter);
+    std::vector<std::thread> producers;
+    std::atomic<int> running(3);
+    for (const char* name : {"audio", "network", "gameplay"}) {
+        producers.emplace_back([&sharedQueue, &running, name] {
+            for (int i = 0; i < 100; ++i) {
+                sharedQueue.enqueue(std::make_shared<MessageEvent>(std::string(name) + " event " + std::to_string(i)));
+            }
+            --running;
+        });
+    }
+    // Keep draining while the producers run: a full queue makes them wait for us
+    while (running > 0) {
+        sharedQueue.processEvents();
+        std::this_thread::yield();
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    sharedQueue.processEvents();
+    std::cout << "**Events From Other Threads Processed**" << std::endl;
+    for (const auto& count : counter.counts()) {
+        std::cout << count.first << ": " << count.second << " events" << std::endl;
+    }
+
+    // Store events by value in the ring. Repeated text is interned, text built
+    // this frame goes into an arena that is reset once the frame's events are processed.
+    InlineEventQueue inlineQueue(16);
+    StringInterner interner;
+    FrameArena frameText;
+    InlineConsoleLogger inlineLogger;
+    inlineQueue.addListener(&inlineLogger);
+    inlineQueue.enqueue(MESSAGE_EVENT, 0, MessagePayload{interner.intern("Game started.")});
+    inlineQueue.enqueue(POSITION_CHANGED_EVENT, 42, PositionPayload{1.5f, 2.0f, 0.0f});
+    inlineQueue.enqueue(PLAY_SOUND_EVENT, 42, SoundPayload{7, 0.5f});
+    inlineQueue.enqueue(MESSAGE_EVENT, 42, MessagePayload{frameText.copy("Player " + std::to_string(42) + " scored.")});
+    inlineQueue.processEvents();
+    frameText.reset();
+    std::cout << "**Inline Events Processed**" << std::endl;
+
+    // A burst of 10 events, handled at most 4 per frame; the rest carry over
+    InlineEventQueue burstQueue(16);
+    InlineRunLogger runLogger;
+    burstQueue.addListener(&runLogger);
+    for (std::uint32_t entity = 1; entity <= 5; ++entity) {
+        burstQueue.enqueue(POSITION_CHANGED_EVENT, entity, PositionPayload{1.0f * entity, 0.0f, 0.0f});
+    }
+    burstQueue.enqueue(PLAY_SOUND_EVENT, 2, SoundPayload{9, 1.0f});
+    burstQueue.enqueue(PLAY_SOUND_EVENT, 4, SoundPayload{9, 1.0f});
+    for (std::uint32_t entity = 6; entity <= 8; ++entity) {
+        burstQueue.enqueue(POSITION_CHANGED_EVENT, entity, PositionPayload{1.0f * entity, 0.0f, 0.0f});
+    }
+    for (int frame = 1; burstQueue.size() > 0; ++frame) {
+        std::cout << "Frame " << frame << ":" << std::endl;
+        size_t dispatched = burstQueue.processEvents(EventBudget(4));
+        std::cout << "    " << dispatched << " dispatched, " << burstQueue.size() << " left" << std::endl;
+    }
+    std::cout << "**Burst Processed Over Several Frames**" << std::endl;
+
+    // Within a frame only the last position of an entity and one play of a sound matter
+    InlineEventQueue coalescingQueue(16);
+    coalescingQueue.coalesce(POSITION_CHANGED_EVENT, keepLatest);
+    coalescingQueue.coalesce(PLAY_SOUND_EVENT, keepFirst);
+    coalescingQueue.addListener(&inlineLogger);
+    for (float step = 1.0f; step <= 3.0f; step += 1.0f) {
+        coalescingQueue.enqueue(POSITION_CHANGED_EVENT, 42, PositionPayload{step, step, 0.0f});
+        coalescingQueue.enqueue(PLAY_SOUND_EVENT, 42, SoundPayload{7, 0.5f});
+        coalescingQueue.enqueue(POSITION_CHANGED_EVENT, 7, PositionPayload{0.0f, -step, 0.0f});
+    }
+    coalescingQueue.processEvents();
+    std::cout << "**Coalesced Events Processed (" << coalescingQueue.coalesced() << " of 9 events saved)**"
+              << std::endl;
+
+    // Subscribe the same listeners to MessageEvents only: no broadcast, no dynamic_cast
+    TypedEventQueue typedQueue(16);
+    typedQueue.subscribe<MessageEvent>(&logger);
+    typedQueue.subscribe<MessageEvent>(&alerter);
+    typedQueue.enqueue(std::make_shared<MessageEvent>("Level loaded."));
+    typedQueue.enqueue(std::make_shared<ScoreEvent>(250)); // No subscribers: released untouched
+    typedQueue.enqueue(std::make_shared<MessageEvent>("Disk error while saving."));
+    std::shared_ptr<Event> untyped = std::make_shared<MessageEvent>("Autosave done."); // Still a MessageEvent
+    typedQueue.enqueue(untyped);
+    typedQueue.processEvents();
+    std::cout << "**Typed Events Processed (" << typedQueue.unhandled() << " without subscribers)**" << std::endl;
+
+    // Overfill a queue that holds 3 events with 6 events under each overflow policy
+    const char* policyNames[] = {"DROP_NEWEST", "DROP_OLDEST", "COALESCE_BY_KEY", "GROW"};
+    OverflowPolicy policies[] = {OverflowPolicy::DROP_NEWEST, OverflowPolicy::DROP_OLDEST,
+                                 OverflowPolicy::COALESCE_BY_KEY, OverflowPolicy::GROW};
+    MessageRecorder recorder;
+    for (size_t p = 0; p < 4; ++p) {
+        RingBufferEventQueue smallQueue(4, policies[p], unitKey);
+        smallQueue.addListener(&recorder);
+        for (const char* message : {"unit 1 moved", "unit 2 moved", "unit 3 moved", "unit 1 attacked",
+                                    "unit 4 moved", "unit 2 died"}) {
+            smallQueue.enqueue(std::make_shared<MessageEvent>(message));
+        }
+        smallQueue.processEvents();
+        const EventQueueStats& stats = smallQueue.stats();
+        std::cout << policyNames[p] << " delivered: " << recorder.take() << std::endl;
+        std::cout << "    dropped " << stats.dropped << ", coalesced " << stats.coalesced << ", grown "
+                  << stats.grown << ", high-water mark " << stats.highWaterMark << std::endl;
+    }
+
+    // BLOCK: a producer thread waits for the main thread to make room
+    RingBufferEventQueue blockingQueue(4, OverflowPolicy::BLOCK);
+    blockingQueue.addListener(&recorder);
+    std::atomic<bool> producerDone(false);
+    std::thread producer([&] {
+        for (int i = 1; i <= 6; ++i) {
+            blockingQueue.enqueue(std::make_shared<MessageEvent>("event " + std::to_string(i)));
+        }
+        producerDone = true;
+    });
+    while (!producerDone) {
+        blockingQueue.processEvents(EventBudget(2)); // A couple of events per frame
+        std::this_thread::yield();
+    }
+    producer.join();
+    blockingQueue.processEvents();
+    std::cout << "BLOCK delivered: " << recorder.take() << std::endl;
+
+    // Delayed damage and a cooldown on later ticks; urgent events jump the line
+    ScheduledEventQueue scheduledQueue(8);
+    scheduledQueue.addListener(&recorder);
+    scheduledQueue.enqueue(std::make_shared<MessageEvent>("autosave done"), EventPriority::LOW);
+    scheduledQueue.enqueue(std::make_shared<MessageEvent>("player hit"), EventPriority::HIGH);
+    scheduledQueue.enqueue(std::make_shared<MessageEvent>("enemy spawned"));
+    for (std::uint64_t tick = 1; tick <= 3; ++tick) {
+        scheduledQueue.scheduleIn(std::make_shared<MessageEvent>("poison " + std::to_string(tick)), tick * 2);
+    }
+    scheduledQueue.schedule(std::make_shared<MessageEvent>("fireball ready"), 3, EventPriority::HIGH);
+    for (std::uint64_t tick = 0; tick <= 6; ++tick) {
+        scheduledQueue.advanceTo(tick);
+        scheduledQueue.processEvents();
+        std::cout << "Tick " << tick << ": " << recorder.take() << std::endl;
+    }
+    std::cout << "**Scheduled Events Processed**" << std::endl;
+
+    // Record a session to a journal, then play it back twice as fast
+    EventCodecs codecs;
+    codecs.add<MessageEvent>(1, encodeMessageEvent, decodeMessageEvent);
+    {
+        RingBufferEventQueue recordedQueue(16);
+        EventJournal journal("event-journal.bin", codecs);
+        recordedQueue.addListener(&journal);
+        for (const char* message : {"wave 1 started", "unit 3 died", "wave 1 cleared"}) {
+            recordedQueue.enqueue(std::make_shared<MessageEvent>(message));
+            recordedQueue.processEvents();
+            std::this_thread::sleep_for(std::chrono::milliseconds(20)); // One frame
+        }
+        std::cout << "Journal recorded " << journal.recorded() << " events" << std::endl;
+    } // The journal's destructor writes the rest and closes the file
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    {
+        EventJournalReplay replay("event-journal.bin", codecs);
+        replay.addListener(&recorder);
+        auto replayStart = std::chrono::steady_clock::now();
+        size_t replayed = replay.run(2.0);
+        auto replayTime = std::chrono::steady_clock::now() - replayStart;
+        std::cout << "Replayed " << replayed << " events: " << recorder.take() << std::endl;
+        std::cout << "    recorded over " << duration_cast<milliseconds>(replay.recordedDuration()).count()
+                  << " ms, replayed in " << duration_cast<milliseconds>(replayTime).count() << " ms" << std::endl;
+    } // Closes the journal before it is deleted
+    std::remove("event-journal.bin");
+
+    // A slow listener called inline holds up processEvents(); on a worker it does not
+    ListenerWorker loggingWorker; // Declared before the AsyncListener, so it outlives it
+    SlowConsoleLogger slowLogger;
+    AsyncListener asyncLogger(slowLogger, loggingWorker);
+    long frameMilliseconds[2];
+    for (int async = 0; async < 2; ++async) {
+        RingBufferEventQueue frameQueue(8);
+        frameQueue.addListener(async ? static_cast<EventListener*>(&asyncLogger) : &slowLogger);
+        frameQueue.addListener(&recorder);
+        for (const char* message : {"frame 1", "frame 2", "frame 3"}) {
+            frameQueue.enqueue(std::make_shared<MessageEvent>(message));
+        }
+        auto frameStart = std::chrono::steady_clock::now();
+        frameQueue.processEvents();
+        frameMilliseconds[async] = static_cast<long>(
+            duration_cast<milliseconds>(std::chrono::steady_clock::now() - frameStart).count());
+        asyncLogger.waitUntilIdle(); // Only so the output below is not interleaved with the worker's
+        recorder.take();
+    }
+    std::cout << "processEvents() took " << frameMilliseconds[0] << " ms with the slow logger inline, "
+              << frameMilliseconds[1] << " ms with it on a worker" << std::endl;
+    std::cout << "    worker delivered " << asyncLogger.delivered() << " events, dropped " << asyncLogger.dropped()
+              << ", longest wait " << duration_cast<milliseconds>(asyncLogger.maxLatency()).count() << " ms"
+              << std::endl;
+
     return 0;
 }
 
@@ -157,5 +352,25 @@ The `RingBufferEventQueue` uses a fixed-size `std::array` to implement the ring
 
 The `processEvents` method dequeues events one by one and calls `notifyListeners`. `notifyListeners` then iterates through all registered `EventListener` objects and calls their `onEvent` method, effectively broadcasting the event. The use of `std::unique_ptr` ensures that memory is managed correctly according to the "pass ownership" design choice.
 
+**Posting from other threads:** `RingBufferEventQueue` is not synchronized, so only one thread may use it. `concurrent-event-queue.hpp` adds lock-free versions for events posted by audio, network or gameplay threads and processed on the main thread: `SpscEventQueue` for one producer thread and `MpscEventQueue` for any number of them. Their capacity is rounded up to a power of two so indices wrap with a mask instead of `%`, and the indices written by different threads sit on separate cache lines. `main()` posts 300 events from three threads while draining on the main thread. `bench_event_queue` measures events/sec and latency percentiles with 1 to 16 producers.
+
+**Events by value:** Every `MessageEvent` is a heap allocation with atomic reference counts, and the ring stores pointers to it. `InlineEventQueue` (`inline-event-queue.hpp`) stores `InlineEvent` records in the ring itself instead. Each record is 24 bytes: a type ID, a target entity and a payload buffer holding any small trivially copyable struct, such as `PositionPayload` or `SoundPayload`. Text is referred to with a `TextRef`. Text that repeats is stored once by a `StringInterner`, and text built during the frame goes into a `FrameArena` that is reset once the frame's events are processed. After warm-up, enqueueing and dispatching allocate nothing; `bench_event_queue` compares the cost per event and allocations per event with the `shared_ptr` queue.
+
+**Per-type dispatch:** Broadcasting calls every listener for every event, and each listener has to `dynamic_cast` to find out whether it cares. With `TypedEventQueue` (`typed-event-queue.hpp`) listeners implement `Subscriber<E>` and subscribe to exactly the event classes they handle. The queue stores a dense type ID next to each event, so dispatch is one table lookup followed by direct calls with the event already cast, and events nobody subscribed to are released without being looked at. The ID is taken from the event's dynamic type, so an event enqueued through a `shared_ptr<Event>` still reaches the subscribers of its class. `InlineEventQueue::subscribe()` does the same for value-typed events by type ID. `bench_event_queue` compares both approaches with 50 event types and 200 listeners.
+
+**Overflow policies:** The original ring only `assert`ed on overflow, so release builds overwrote unprocessed events. `RingBufferEventQueue` now takes an `OverflowPolicy`. `BLOCK` makes producers on other threads wait for `processEvents()`; the thread running `processEvents()` cannot wait for itself, so its enqueues grow the ring instead. `DROP_NEWEST` and `DROP_OLDEST` discard an event. `COALESCE_BY_KEY` replaces a queued event that has the same key as the new one. `GROW` doubles the ring, which is safe even when a listener enqueues during `processEvents()`. `stats()` reports how many events were dropped or coalesced, how often the ring grew or producers blocked, and the high-water mark, so capacities can be chosen from real numbers.
+
+**Frame budgets:** `processEvents()` drains the whole queue, so a burst of events stalls the frame it arrives in. `processEvents(EventBudget)` stops after a number of events or an amount of time and leaves the rest queued for the next frame; `main()` spreads a burst of 10 events over three frames. The clock is read once per batch of 64 events rather than per event. `InlineEventQueue` also hands listeners runs of consecutive same-type events through `InlineEventListener::onEvents()`, a pointer and a count into the ring itself, so a listener can process a run in one tight loop with one virtual call. Listeners that only implement `onEvent()` still get one call per event. `bench_event_queue` compares per-event and per-run dispatch and shows the longest frame of a burst with and without a budget.
+
+**Coalescing:** Many events are redundant within a frame: an entity that moves three times only needs its last position dispatched, and a sound requested twice should play once. `InlineEventQueue::coalesce(type, merge)` turns on coalescing for one event type. While an event with the same type and target is still waiting, a new one is passed to `merge` together with the queued event instead of being queued: `keepLatest` replaces the queued event, `keepFirst` drops the new one, and any other function can combine the two (adding up damage, say). The merged event keeps the queued event's place in line, and `coalesced()` counts the events saved. The queued events are found through an open-addressing table sized with the ring, so coalescing allocates nothing either. In `main()` 9 events for two entities shrink to 3; `bench_event_queue` measures the dispatch work saved under bursty load.
+
+**Priorities and deferred delivery:** `ScheduledEventQueue` (`scheduled-event-queue.hpp`) has three lanes, `HIGH`, `NORMAL` and `LOW`, each a growable `RingBufferEventQueue`. `processEvents()` drains them in that order, so with a budget it is low priority events that wait for the next frame. `schedule()` and `scheduleIn()` hold an event back until a later tick, such as delayed damage or a cooldown running out; the game loop calls `advanceTo()` each frame and due events join their lane. Pending events sit in a `TimingWheel`: four levels of 256 slots, where level 0 has one slot per tick and each higher level one slot per 256 slots of the level below. An event is appended to one slot when scheduled and moves down a level whenever the current tick enters its slot, at most three times, so the work per timer does not grow with the number pending. A bitmap per level lets `advanceTo()` jump to the next occupied slot, and an `advanceTo()` that reaches no timer is a single comparison. A sorted container such as `std::multimap` pays a tree walk with a cache miss per level instead. `bench_event_queue` compares the two while advancing one tick at a time over 2^20 ticks. Scheduling on the wheel is several times cheaper at every size. With tens of thousands of timers or more, firing is cheaper too. With only a few hundred timers spread over that many ticks, the per-tick `advanceTo()` call dominates, and firing costs the wheel about twice as much per timer as the multimap, though that is still only about 2 ns per tick.
+
+**Journal and replay:** `EventJournal` (`event-journal.hpp`) is a listener that appends every event passing through `processEvents()` to a binary file. Each record is the time since the previous record, a codec ID and the event's payload, with the numbers stored as varints so a short message costs a few bytes on top of its text. Codecs are registered per event class in `EventCodecs`, and events without one are counted and skipped. The game thread only encodes into a memory buffer. Full buffers go to a writer thread through an `SpscRing` and come back empty through another, so recording never waits for the disk. `EventJournalReplay` feeds a journal back to listeners at the recorded pace, faster, or as fast as they can go, which turns a captured incident into a reproducible test and a recorded session into a repeatable load test. `main()` records three frames and replays them at double speed; `bench_event_queue` measures the recording overhead per event and the replay rate.
+
+**Listeners on workers:** Listeners are called one after another on the thread running `processEvents()`, so one slow listener, such as a logger flushing `std::cout`, delays the others and the frame. Wrapping it in an `AsyncListener` (`async-listener.hpp`) pins it to a `ListenerWorker` thread. On the queue's thread the wrapper only pushes the event into its own `SpscRing`; the worker calls the real listener. Each listener sees its events in order, and listeners pinned to the same worker never run concurrently, so a worker also serves as a strand for listeners that share state. Events are not ordered across listeners, since the worker delivers a batch to each listener in turn. Each `AsyncListener` reports its lag (events handed over but not yet delivered), its longest wait and the events it dropped. A listener that falls a whole ring behind loses events itself instead of stalling the frame. `main()` shows `processEvents()` going from 30 ms to nothing when the slow logger moves to a worker.
+
+**Benchmarks:** `bench_event_queue [events] [json-path]` runs every comparison mentioned above, then a suite that measures `RingBufferEventQueue` at capacities of 16, 256 and 4096, with 1, 4 and 16 listeners and 8, 64 and 1024 byte messages. For each combination it reports the cost of `enqueue()`, the dispatch cost per listener, p50/p99/p999 latency from `enqueue()` to the last listener, and allocations per event. The suite's results are also written as JSON (`bench-event-queue.json` by default), so runs from different releases can be compared.
+
 This example showcases the basic structure of an event queue with the specified design considerations. In a more complex system, you might have different types of events and more sophisticated listener management.
 */
\ No newline at end of file
@@ -0,0 +1,333 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// Forward declaration
+class EventListener;
+
+// Base class for events
+class Event /*: public std::enable_shared_from_this<Event>*/ {
+public:
+    virtual ~Event() = default;
+    virtual void process(EventListener* listener) = 0;
+};
+
+// Concrete example event: MessageEvent
+class MessageEvent : public Event, public std::enable_shared_from_this<MessageEvent> {
+public:
+    MessageEvent(std::string message) : message_(std::move(message)) {}
+    void process(EventListener* listener) override;
+    const std::string& getMessage() const { return message_; }
+private:
+    std::string message_;
+};
+
+// Interface for event listeners (observers)
+class EventListener {
+public:
+    virtual ~EventListener() = default;
+    virtual void onEvent(std::shared_ptr<Event> event) = 0;
+};
+
+// Interface for listeners that only want one type of event. Subscribed with
+// TypedEventQueue::subscribe() (typed-event-queue.hpp), they are only called
+// for events of exactly type E, already cast, so they need no dynamic_cast.
+template <typename E>
+class Subscriber {
+public:
+    virtual ~Subscriber() = default;
+    virtual void onEvent(const E& event) = 0;
+};
+
+// Implementation of MessageEvent's process method
+inline void MessageEvent::process(EventListener* listener) {
+    listener->onEvent(shared_from_this()); // Transfer ownership to the listener
+}
+
+// Concrete example listener: ConsoleLogger
+class ConsoleLogger : public EventListener, public Subscriber<MessageEvent> {
+public:
+    void onEvent(const MessageEvent& event) override {
+        std::cout << "ConsoleLogger received: " << event.getMessage() << std::endl;
+    }
+
+    void onEvent(std::shared_ptr<Event> event) override {
+        if (auto messageEvent = dynamic_cast<MessageEvent*>(event.get())) {
+            std::cout << "ConsoleLogger received: " << messageEvent->getMessage() << std::endl;
+        } else {
+            std::cout << "ConsoleLogger received an unknown event type." << std::endl;
+        }
+        // Ownership of the event is now with ConsoleLogger (though we don't need it after processing here)
+    }
+};
+
+// Concrete example listener: AlertSystem
+class AlertSystem : public EventListener, public Subscriber<MessageEvent> {
+public:
+    void onEvent(const MessageEvent& event) override {
+        if (event.getMessage().find("error") != std::string::npos) {
+            std::cerr << "**ALERT SYSTEM**: Error detected: " << event.getMessage() << std::endl;
+        }
+    }
+
+    void onEvent(std::shared_ptr<Event> event) override {
+        if (auto messageEvent = dynamic_cast<MessageEvent*>(event.get())) {
+            if (messageEvent->getMessage().find("error") != std::string::npos) {
+                std::cerr << "**ALERT SYSTEM**: Error detected: " << messageEvent->getMessage() << std::endl;
+            }
+        }
+        // Ownership of the event is now with AlertSystem
+    }
+};
+
+// Budgeted processEvents() dispatches this many events between reads of the clock
+const size_t eventBatchSize = 64;
+
+// How much processEvents() may do in one call, e.g. per frame. Whatever is
+// left stays queued for the next call. The time limit is checked between
+// batches, so a call can overrun it by one batch.
+struct EventBudget {
+    size_t maxEvents;
+    std::chrono::nanoseconds maxTime;
+
+    explicit EventBudget(size_t maxEvents = SIZE_MAX,
+                         std::chrono::nanoseconds maxTime = std::chrono::nanoseconds::max())
+        : maxEvents(maxEvents), maxTime(maxTime) {}
+
+    static EventBudget time(std::chrono::nanoseconds maxTime) { return EventBudget(SIZE_MAX, maxTime); }
+};
+
+// What RingBufferEventQueue::enqueue() does when the ring is full
+enum class OverflowPolicy {
+    BLOCK,           // Wait until processEvents() on another thread makes room; GROW on that thread
+    DROP_NEWEST,     // Discard the event being enqueued
+    DROP_OLDEST,     // Discard the oldest queued event to make room
+    COALESCE_BY_KEY, // Replace a queued event with the same key, else drop the new one
+    GROW             // Double the capacity
+};
+
+// Counters for sizing queues from real data instead of guessing
+struct EventQueueStats {
+    size_t enqueued = 0;      // Events accepted into the queue
+    size_t dropped = 0;       // Events discarded by DROP_NEWEST, DROP_OLDEST or COALESCE_BY_KEY
+    size_t coalesced = 0;     // Queued events replaced by a newer one with the same key
+    size_t blocked = 0;       // Times enqueue() had to wait for room
+    size_t grown = 0;         // Times the ring was reallocated
+    size_t highWaterMark = 0; // Most events ever waiting at once
+};
+
+// Ring buffer based event queue
+class RingBufferEventQueue {
+public:
+    // Returns the key events are coalesced by; events with different keys never replace each other
+    using CoalesceKey = std::uint64_t (*)(const Event& event);
+
+    // The ring holds capacity - 1 events. With OverflowPolicy::BLOCK, enqueue()
+    // may be called from other threads and is synchronized with processEvents();
+    // with every other policy the queue belongs to one thread. Only other
+    // threads can wait for room: the thread that calls processEvents(), e.g. a
+    // listener posting a follow-up event, grows the ring instead.
+    RingBufferEventQueue(size_t capacity, OverflowPolicy policy = OverflowPolicy::DROP_NEWEST,
+                         CoalesceKey coalesceKey = nullptr)
+        : capacity_(capacity < 2 ? 2 : capacity), buffer_(capacity_), policy_(policy), coalesceKey_(coalesceKey) {
+        assert(policy != OverflowPolicy::COALESCE_BY_KEY || coalesceKey);
+    }
+
+    void enqueue(std::shared_ptr<Event> event) {
+        std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+        if (policy_ == OverflowPolicy::BLOCK) {
+            lock.lock();
+        }
+
+        if ((head_ + 1) % capacity_ == tail_) { // Overflow
+            switch (policy_) {
+                case OverflowPolicy::BLOCK:
+                    if (std::this_thread::get_id() == consumer_) {
+                        grow(); // Waiting would deadlock: only this thread makes room
+                        break;
+                    }
+                    ++stats_.blocked;
+                    roomAvailable_.wait(lock, [this] { return (head_ + 1) % capacity_ != tail_; });
+                    break;
+                case OverflowPolicy::DROP_NEWEST:
+                    ++stats_.dropped;
+                    return;
+                case OverflowPolicy::DROP_OLDEST:
+                    buffer_[tail_].reset();
+                    tail_ = (tail_ + 1) % capacity_;
+                    ++stats_.dropped;
+                    break;
+                case OverflowPolicy::COALESCE_BY_KEY: {
+                    std::uint64_t key = coalesceKey_(*event);
+                    for (size_t i = tail_; i != head_; i = (i + 1) % capacity_) {
+                        if (coalesceKey_(*buffer_[i]) == key) {
+                            buffer_[i] = std::move(event); // Keeps the older event's place in line
+                            ++stats_.coalesced;
+                            return;
+                        }
+                    }
+                    ++stats_.dropped;
+                    return;
+                }
+                case OverflowPolicy::GROW:
+                    grow();
+                    break;
+            }
+        }
+
+        buffer_[head_] = std::move(event);
+        head_ = (head_ + 1) % capacity_;
+        ++stats_.enqueued;
+        size_t waiting = (head_ + capacity_ - tail_) % capacity_;
+        if (waiting > stats_.highWaterMark) {
+            stats_.highWaterMark = waiting;
+        }
+    }
+
+    void addListener(EventListener* listener) {
+        listeners_.push_back(listener);
+    }
+
+    void processEvents() {
+        if (policy_ == OverflowPolicy::BLOCK) {
+            for (;;) {
+                std::shared_ptr<Event> event;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    consumer_ = std::this_thread::get_id();
+                    if (tail_ == head_) {
+                        return;
+                    }
+                    event = std::move(buffer_[tail_]);
+                    tail_ = (tail_ + 1) % capacity_;
+                }
+                roomAvailable_.notify_all();
+                notifyListeners(event); // Without the lock, so producers can keep going
+            }
+        }
+
+        while (tail_ != head_) {
+            std::shared_ptr<Event> event = std::move(buffer_[tail_]);
+            tail_ = (tail_ + 1) % capacity_;
+            notifyListeners(event);
+        }
+    }
+
+    // Dispatches events in batches until the queue is empty or the budget runs
+    // out, and returns how many were dispatched. The rest wait for the next call.
+    size_t processEvents(const EventBudget& budget) {
+        const auto start = std::chrono::steady_clock::now();
+        size_t processed = 0;
+        while (processed < budget.maxEvents) {
+            // Move a batch out of the ring, so with BLOCK the lock is taken once per batch
+            {
+                std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+                if (policy_ == OverflowPolicy::BLOCK) {
+                    lock.lock();
+                    consumer_ = std::this_thread::get_id();
+                }
+                size_t limit = std::min(eventBatchSize, budget.maxEvents - processed);
+                while (tail_ != head_ && batch_.size() < limit) {
+                    batch_.push_back(std::move(buffer_[tail_]));
+                    tail_ = (tail_ + 1) % capacity_;
+                }
+            }
+            if (batch_.empty()) {
+                break;
+            }
+            if (policy_ == OverflowPolicy::BLOCK) {
+                roomAvailable_.notify_all();
+            }
+            processed += batch_.size();
+            // Swapped out first: a listener may call processEvents() again
+            std::vector<std::shared_ptr<Event>> batch;
+            batch.swap(batch_);
+            for (std::shared_ptr<Event>& event : batch) {
+                notifyListeners(std::move(event));
+            }
+            batch.clear();
+            batch.swap(batch_); // Keep the capacity for the next batch
+            if (std::chrono::steady_clock::now() - start >= budget.maxTime) {
+                break;
+            }
+        }
+        return processed;
+    }
+
+    // Events waiting to be processed
+    size_t size() const {
+        std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+        if (policy_ == OverflowPolicy::BLOCK) {
+            lock.lock();
+        }
+        return (head_ + capacity_ - tail_) % capacity_;
+    }
+    size_t capacity() const { return capacity_; }
+    OverflowPolicy policy() const { return policy_; }
+
+    // Not synchronized: with OverflowPolicy::BLOCK, read it while no producer is running
+    const EventQueueStats& stats() const { return stats_; }
+
+private:
+    void notifyListeners(std::shared_ptr<Event> event) {
+        for (EventListener* listener : listeners_) {
+            event->process(listener); // Transfer ownership to each listener temporarily
+        }
+        // After processing by all listeners, the original unique_ptr goes out of scope,
+        // but each listener *should* have moved ownership if they needed to keep the event.
+    }
+
+    // Moves the queued events to the front of a ring twice the size. Safe while
+    // processEvents() is running (e.g. a listener enqueues): the event being
+    // dispatched has already been moved out of the ring, and head_/tail_ are
+    // re-read for every event.
+    void grow() {
+        std::vector<std::shared_ptr<Event>> bigger(capacity_ * 2);
+        size_t count = 0;
+        for (size_t i = tail_; i != head_; i = (i + 1) % capacity_) {
+            bigger[count++] = std::move(buffer_[i]);
+        }
+        buffer_.swap(bigger);
+        capacity_ *= 2;
+        tail_ = 0;
+        head_ = count;
+        ++stats_.grown;
+    }
+
+    size_t capacity_;
+    std::vector<std::shared_ptr<Event>> buffer_; // Fixed size unless the policy is GROW
+    size_t head_ = 0;
+    size_t tail_ = 0;
+    std::vector<EventListener*> listeners_;
+    std::vector<std::shared_ptr<Event>> batch_; // Reused by the budgeted processEvents()
+    OverflowPolicy policy_;
+    CoalesceKey coalesceKey_;
+    EventQueueStats stats_;
+    mutable std::mutex mutex_;              // Only used with OverflowPolicy::BLOCK
+    std::condition_variable roomAvailable_; // Only used with OverflowPolicy::BLOCK
+    std::thread::id consumer_;              // Last thread to call processEvents(), with BLOCK
+};
+
+// Single writer class
+class EventGenerator {
+public:
+    EventGenerator(RingBufferEventQueue& queue) : eventQueue_(queue) {}
+
+    void generateMessage(std::string message) {
+        std::cout << "EventGenerator sending: " << message << std::endl;
+        eventQueue_.enqueue(std::make_shared<MessageEvent>(message));
+    }
+private:
+    RingBufferEventQueue& eventQueue_;
+};
@@ -0,0 +1,417 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "concurrent-event-queue.hpp"
+
+// Value-typed events
+// ------------------
+// RingBufferEventQueue stores shared_ptr<Event>, so every event is a heap
+// allocation plus atomic reference counting, and the listener has to chase a
+// pointer to reach it. InlineEventQueue stores events by value: an
+// InlineEvent is a fixed-size POD record with a type tag, the entity it is
+// about and a small payload buffer holding any trivially copyable struct.
+// Text does not live in the event either; payloads refer to it with a
+// TextRef into a StringInterner (text that repeats, like "Game started.") or a
+// FrameArena (text built per frame, valid until the arena is reset).
+
+// A view of text owned by a StringInterner or FrameArena
+struct TextRef {
+    const char* data;
+    std::uint32_t length;
+
+    std::string str() const { return std::string(data, length); }
+};
+
+// Stores each distinct string once and hands out TextRefs that stay valid for
+// the interner's lifetime. Interning text that was seen before allocates
+// nothing: the lookup hashes and compares the caller's characters in place.
+class StringInterner {
+public:
+    TextRef intern(const char* text, size_t length) {
+        auto found = index_.find(TextRef{text, static_cast<std::uint32_t>(length)});
+        if (found != index_.end()) {
+            return *found;
+        }
+        strings_.emplace_back(new std::string(text, length));
+        TextRef ref{strings_.back()->data(), static_cast<std::uint32_t>(length)};
+        index_.insert(ref);
+        return ref;
+    }
+
+    TextRef intern(const std::string& text) {
+        return intern(text.data(), text.size());
+    }
+
+    size_t size() const { return strings_.size(); }
+
+private:
+    struct Hash {
+        size_t operator()(const TextRef& text) const {
+            size_t hash = 14695981039346656037ull; // FNV-1a
+            for (std::uint32_t i = 0; i < text.length; ++i) {
+                hash = (hash ^ static_cast<unsigned char>(text.data[i])) * 1099511628211ull;
+            }
+            return hash;
+        }
+    };
+
+    struct Equal {
+        bool operator()(const TextRef& a, const TextRef& b) const {
+            return a.length == b.length && std::memcmp(a.data, b.data, a.length) == 0;
+        }
+    };
+
+    std::vector<std::unique_ptr<std::string>> strings_; // Never move, so TextRefs stay valid
+    std::unordered_set<TextRef, Hash, Equal> index_;     // Refers into strings_
+};
+
+// A bump allocator for text that only lives for one frame. reset() frees
+// everything at once and keeps the memory, so after the first few frames
+// copying text in allocates nothing.
+class FrameArena {
+public:
+    explicit FrameArena(size_t blockSize = 64 * 1024) : blockSize_(blockSize) {}
+
+    TextRef copy(const char* text, size_t length) {
+        if (blocks_.empty() || used_ + length > blocks_[current_].size) {
+            nextBlock(length);
+        }
+        char* out = blocks_[current_].data.get() + used_;
+        std::memcpy(out, text, length);
+        used_ += length;
+        return {out, static_cast<std::uint32_t>(length)};
+    }
+
+    TextRef copy(const std::string& text) {
+        return copy(text.data(), text.size());
+    }
+
+    // Invalidates every TextRef handed out since the last reset
+    void reset() {
+        current_ = 0;
+        used_ = 0;
+    }
+
+    size_t capacity() const {
+        size_t total = 0;
+        for (const Block& block : blocks_) total += block.size;
+        return total;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    void nextBlock(size_t length) {
+        // Reuse the next block left over from an earlier frame if it is big enough
+        while (!blocks_.empty() && current_ + 1 < blocks_.size()) {
+            ++current_;
+            used_ = 0;
+            if (length <= blocks_[current_].size) return;
+        }
+        size_t size = length > blockSize_ ? length : blockSize_;
+        blocks_.push_back({std::unique_ptr<char[]>(new char[size]), size});
+        current_ = blocks_.size() - 1;
+        used_ = 0;
+    }
+
+    size_t blockSize_;
+    std::vector<Block> blocks_;
+    size_t current_ = 0;
+    size_t used_ = 0;
+};
+
+// Event type IDs. Any value may be used; these are the ones the examples know.
+enum InlineEventType : std::uint32_t {
+    MESSAGE_EVENT = 0,          // MessagePayload
+    POSITION_CHANGED_EVENT = 1, // PositionPayload
+    PLAY_SOUND_EVENT = 2        // SoundPayload
+};
+
+struct MessagePayload {
+    TextRef text;
+};
+
+struct PositionPayload {
+    float x, y, z;
+};
+
+struct SoundPayload {
+    std::uint32_t soundId;
+    float volume;
+};
+
+// One event stored by value: 24 bytes, no pointers owned, safe to memcpy
+struct InlineEvent {
+    static const size_t payloadSize = 16;
+
+    std::uint32_t type;   // An InlineEventType or any other ID agreed on by sender and listeners
+    std::uint32_t target; // The entity the event is about, 0 if none
+    alignas(8) unsigned char payload[payloadSize];
+
+    template <typename Payload>
+    static InlineEvent make(std::uint32_t type, std::uint32_t target, const Payload& value) {
+        static_assert(std::is_trivially_copyable<Payload>::value, "Event payloads must be trivially copyable");
+        static_assert(sizeof(Payload) <= payloadSize, "Event payload does not fit in an InlineEvent");
+        InlineEvent event;
+        event.type = type;
+        event.target = target;
+        std::memcpy(event.payload, &value, sizeof(Payload));
+        std::memset(event.payload + sizeof(Payload), 0, payloadSize - sizeof(Payload));
+        return event;
+    }
+
+    template <typename Payload>
+    Payload as() const {
+        static_assert(std::is_trivially_copyable<Payload>::value, "Event payloads must be trivially copyable");
+        static_assert(sizeof(Payload) <= payloadSize, "Event payload does not fit in an InlineEvent");
+        Payload value;
+        std::memcpy(&value, payload, sizeof(Payload));
+        return value;
+    }
+};
+
+static_assert(std::is_trivially_copyable<InlineEvent>::value, "InlineEvent must stay a POD record");
+static_assert(sizeof(InlineEvent) == 24, "InlineEvent should stay small");
+
+// Receives InlineEvents by reference. The event is only valid during the
+// call; copy it (it is 24 bytes) to keep it.
+class InlineEventListener {
+public:
+    virtual ~InlineEventListener() = default;
+    virtual void onEvent(const InlineEvent& event) = 0;
+
+    // Receives `count` consecutive events that all have the same type, lying
+    // next to each other in memory. Override it to handle a run in one tight
+    // loop with one virtual call; by default each event goes to onEvent().
+    virtual void onEvents(const InlineEvent* events, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            onEvent(events[i]);
+        }
+    }
+};
+
+// Combines an event being enqueued into a queued event with the same type and
+// target. keepLatest() and keepFirst() cover the common cases.
+using InlineEventMerge = void (*)(InlineEvent& queued, const InlineEvent& incoming);
+
+// The newer event supersedes the queued one, e.g. "position changed"
+inline void keepLatest(InlineEvent& queued, const InlineEvent& incoming) {
+    queued = incoming;
+}
+
+// The newer event is a duplicate and is dropped, e.g. "play sound"
+inline void keepFirst(InlineEvent&, const InlineEvent&) {}
+
+// RingBufferEventQueue with events stored in the ring itself. Enqueueing
+// copies 24 bytes and dispatching passes a reference, so neither allocates.
+// Like RingBufferEventQueue it is for one thread.
+class InlineEventQueue {
+public:
+    explicit InlineEventQueue(size_t capacity)
+        : mask_(roundUpToPowerOfTwo(capacity < 2 ? 2 : capacity) - 1), buffer_(mask_ + 1) {}
+
+    size_t capacity() const { return mask_ + 1; }
+    size_t size() const { return head_ - tail_; }
+
+    // Drops the event and counts it in dropped() if the ring is full. Events
+    // being dispatched still hold their slots, so a listener that enqueues
+    // during processEvents() never overwrites them, but may find the ring full
+    // up to one run (eventBatchSize events, more in nested calls) early.
+    void enqueue(const InlineEvent& event) {
+        InlineEventMerge merge = mergeFor(event.type);
+        if (merge && mergeIntoQueued(event, merge)) {
+            ++coalesced_;
+            return;
+        }
+        if (head_ - reserved_ == capacity()) {
+            ++dropped_;
+            return;
+        }
+        if (merge) {
+            recordQueued(event);
+        }
+        buffer_[head_ & mask_] = event;
+        ++head_;
+    }
+
+    template <typename Payload>
+    void enqueue(std::uint32_t type, std::uint32_t target, const Payload& payload) {
+        enqueue(InlineEvent::make(type, target, payload));
+    }
+
+    // Listens to every event
+    void addListener(InlineEventListener* listener) {
+        listeners_.push_back(listener);
+    }
+
+    // Listens to events of one type only
+    void subscribe(std::uint32_t type, InlineEventListener* listener) {
+        subscribers_[type].push_back(listener);
+    }
+
+    // Coalesces events of `type`: while an event with the same type and target
+    // is still waiting, a new one is merged into it instead of being queued.
+    // The merged event keeps the queued event's place in line.
+    void coalesce(std::uint32_t type, InlineEventMerge merge) {
+        merges_[type] = merge;
+        if (index_.empty()) {
+            index_.assign(4 * capacity(), IndexEntry{0, emptyEntry});
+        }
+    }
+
+    // Events merged into a queued event instead of being queued and dispatched
+    size_t coalesced() const { return coalesced_; }
+
+    // Events discarded because the ring was full
+    size_t dropped() const { return dropped_; }
+
+    void processEvents() {
+        processEvents(EventBudget());
+    }
+
+    // Dispatches runs of consecutive same-type events through onEvents() until
+    // the queue is empty or the budget runs out, and returns how many events
+    // were dispatched. The rest wait for the next call. Each listener sees a
+    // whole run before the next listener does; the order of the events
+    // themselves is kept. A listener may call processEvents() again: the run
+    // is taken off the queue before it is dispatched.
+    size_t processEvents(const EventBudget& budget) {
+        const auto start = std::chrono::steady_clock::now();
+        size_t processed = 0;
+        size_t nextClockCheck = eventBatchSize;
+        while (tail_ != head_ && processed < budget.maxEvents) {
+            // A run ends at a type change, the end of the ring or the end of the budget
+            const InlineEvent* run = &buffer_[tail_ & mask_];
+            size_t limit = std::min({head_ - tail_, capacity() - (tail_ & mask_), budget.maxEvents - processed,
+                                     eventBatchSize});
+            size_t count = 1;
+            while (count < limit && run[count].type == run->type) {
+                ++count;
+            }
+            // The run leaves the queue, so it is no longer merged into or
+            // handed to a nested processEvents(), but its slots stay reserved
+            // until the outermost call is done with it
+            tail_ += count;
+            ++dispatching_;
+            for (InlineEventListener* listener : listeners_) {
+                listener->onEvents(run, count);
+            }
+            auto subscribed = subscribers_.find(run->type);
+            if (subscribed != subscribers_.end()) {
+                for (InlineEventListener* listener : subscribed->second) {
+                    listener->onEvents(run, count);
+                }
+            }
+            if (--dispatching_ == 0) {
+                reserved_ = tail_;
+            }
+            processed += count;
+            if (processed >= nextClockCheck) {
+                nextClockCheck = processed + eventBatchSize;
+                if (std::chrono::steady_clock::now() - start >= budget.maxTime) {
+                    break;
+                }
+            }
+        }
+        return processed;
+    }
+
+private:
+    // Where the queued event with a coalesced (type, target) key sits in the
+    // ring. Entries for events that have been dispatched are stale and are
+    // skipped; the table is rebuilt from the ring before they fill it up.
+    struct IndexEntry {
+        std::uint64_t key;
+        size_t position; // Ring index as in head_, or emptyEntry
+    };
+
+    static const size_t emptyEntry = SIZE_MAX;
+
+    static std::uint64_t keyOf(const InlineEvent& event) {
+        return static_cast<std::uint64_t>(event.type) << 32 | event.target;
+    }
+
+    size_t firstSlotFor(std::uint64_t key) const {
+        return static_cast<size_t>((key * 11400714819323198485ull) >> 32) & (index_.size() - 1);
+    }
+
+    // The merge registered for `type`, or nullptr if it is not coalesced
+    InlineEventMerge mergeFor(std::uint32_t type) const {
+        if (merges_.empty()) return nullptr;
+        auto found = merges_.find(type);
+        return found != merges_.end() ? found->second : nullptr;
+    }
+
+    // Merges `event` into a waiting event with the same key using `merge` and
+    // returns true, or returns false if there is none
+    bool mergeIntoQueued(const InlineEvent& event, InlineEventMerge merge) {
+        std::uint64_t key = keyOf(event);
+        size_t slot = firstSlotFor(key);
+        for (; index_[slot].position != emptyEntry; slot = (slot + 1) & (index_.size() - 1)) {
+            const IndexEntry& entry = index_[slot];
+            if (entry.key == key && entry.position >= tail_) {
+                merge(buffer_[entry.position & mask_], event);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Records that `event` is about to be queued at head_
+    void recordQueued(const InlineEvent& event) {
+        if (indexUsed_ >= index_.size() / 2) {
+            rebuildIndex();
+        }
+        insertIndex(keyOf(event), head_);
+    }
+
+    void insertIndex(std::uint64_t key, size_t position) {
+        size_t slot = firstSlotFor(key);
+        while (index_[slot].position != emptyEntry) {
+            slot = (slot + 1) & (index_.size() - 1);
+        }
+        index_[slot] = {key, position};
+        ++indexUsed_;
+    }
+
+    // At most capacity() events are waiting, so afterwards the table is at most
+    // a quarter full and the next rebuild is at least capacity() inserts away
+    void rebuildIndex() {
+        std::fill(index_.begin(), index_.end(), IndexEntry{0, emptyEntry});
+        indexUsed_ = 0;
+        for (size_t position = tail_; position != head_; ++position) {
+            const InlineEvent& event = buffer_[position & mask_];
+            if (mergeFor(event.type)) {
+                insertIndex(keyOf(event), position);
+            }
+        }
+    }
+
+    size_t mask_;
+    std::vector<InlineEvent> buffer_;
+    size_t head_ = 0; // Only ever increases; the slot is head_ & mask_
+    size_t tail_ = 0;
+    size_t reserved_ = 0;       // Slots from here to tail_ hold runs still being dispatched
+    size_t dispatching_ = 0;    // Nesting depth of processEvents() dispatching a run
+    std::unordered_map<std::uint32_t, InlineEventMerge> merges_; // Keyed by event type
+    std::vector<IndexEntry> index_;        // Open addressing, 4 * capacity() entries
+    size_t indexUsed_ = 0;
+    size_t coalesced_ = 0;
+    size_t dropped_ = 0;
+    std::vector<InlineEventListener*> listeners_;
+    // Keyed by event type, so the table's size does not depend on the IDs used;
+    // looked up once per run, not per event
+    std::unordered_map<std::uint32_t, std::vector<InlineEventListener*>> subscribers_;
+};
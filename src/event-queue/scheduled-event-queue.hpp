@@ -0,0 +1,285 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "event-queue.hpp"
+
+// Deferred delivery
+// -----------------
+// A hierarchical timing wheel holds timers keyed by the tick they are due on.
+// Ticks are whatever the caller advances by: frames, milliseconds, turns.
+//
+// There are four levels of 256 slots. Level 0 has one slot per tick for the
+// next 256 ticks, level 1 one slot per 256 ticks for the next 65536, and so
+// on. Scheduling a timer appends it to one slot, and every time the current
+// tick crosses a slot boundary on a higher level, that slot's timers move
+// down to the level below. Each timer moves at most three times before it
+// fires, so scheduling and firing cost O(1) per timer no matter how many are
+// pending, where a sorted container pays O(log n) and a cache miss per level
+// of the tree. Each slot is a vector, so handing timers down and firing them
+// walk memory in order, and once the vectors have grown scheduling allocates
+// nothing. A bitmap per level records which slots hold timers, so advancing
+// jumps straight to the next occupied slot instead of visiting every tick,
+// and the tick of that slot is remembered until the wheel changes, so an
+// advanceTo() that reaches no timer costs a comparison.
+
+template <typename T>
+class TimingWheel {
+public:
+    explicit TimingWheel(std::uint64_t now = 0) : next_(now + 1) {}
+
+    // The last tick advanceTo() has processed
+    std::uint64_t now() const { return next_ - 1; }
+
+    // Timers waiting to fire
+    size_t size() const { return size_; }
+
+    // Fires `value` on tick `due`. Timers due on or before now() fire on the
+    // next tick.
+    void schedule(T value, std::uint64_t due) {
+        insert(Timer{std::move(value), due});
+        ++size_;
+    }
+
+    // Processes every tick up to and including `tick`, calling fire(T&&) for
+    // each timer as it comes due. Timers due on the same tick fire together,
+    // not necessarily in the order they were scheduled. fire() may schedule
+    // more timers.
+    template <typename Fire>
+    void advanceTo(std::uint64_t tick, Fire&& fire) {
+        while (next_ <= tick) {
+            // Nothing happens before an occupied slot comes up, so skip the
+            // empty ticks up to it
+            if (!dueKnown_) {
+                due_ = nextOccupiedTick();
+                dueKnown_ = true;
+            }
+            if (due_ > tick) {
+                next_ = tick + 1;
+                return;
+            }
+            next_ = due_;
+            step(fire);
+        }
+    }
+
+private:
+    static const int levels = 4;
+    static const int slotBits = 8;
+    static const size_t slotCount = 1 << slotBits;
+    static const size_t wordCount = slotCount / 64; // Of each level's occupancy bitmap
+
+    struct Timer {
+        T value;
+        std::uint64_t due;
+    };
+
+    void insert(Timer&& timer) {
+        // Due ticks that have passed are fired on the next one
+        std::uint64_t at = timer.due > next_ ? timer.due : next_;
+        std::uint64_t delta = at - next_;
+        if (delta >> (levels * slotBits)) {
+            // Beyond the wheel: park it in the farthest slot, it is re-sorted from there
+            delta = (std::uint64_t(1) << (levels * slotBits)) - 1;
+            at = next_ + delta;
+        }
+        int level = 0;
+        while (delta >> ((level + 1) * slotBits)) {
+            ++level;
+        }
+        size_t slot = (at >> (level * slotBits)) & (slotCount - 1);
+        slots_[level][slot].push_back(std::move(timer));
+        occupied_[level][slot / 64] |= std::uint64_t(1) << (slot % 64);
+        ++levelSize_[level];
+        dueKnown_ = false;
+    }
+
+    // Empties a slot into scratch_
+    void takeSlot(int level, size_t slot) {
+        scratch_.swap(slots_[level][slot]);
+        occupied_[level][slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+        levelSize_[level] -= scratch_.size();
+        dueKnown_ = false;
+    }
+
+    // The first tick from next_ on at which an occupied slot is fired (level 0)
+    // or handed down (higher levels), or UINT64_MAX if there are no timers
+    std::uint64_t nextOccupiedTick() const {
+        std::uint64_t earliest = UINT64_MAX;
+        for (int level = 0; level < levels; ++level) {
+            if (levelSize_[level] == 0) {
+                continue;
+            }
+            // Slots are handed down on this level's boundaries, the first of
+            // them at or after next_
+            int shift = level * slotBits;
+            std::uint64_t boundary = (next_ + (std::uint64_t(1) << shift) - 1) >> shift;
+            std::uint64_t at = (boundary + slotsToOccupied(level, boundary & (slotCount - 1))) << shift;
+            if (at < earliest) {
+                earliest = at;
+            }
+        }
+        return earliest;
+    }
+
+    // How many slots on from `from`, wrapping around, the first occupied slot
+    // of `level` is. The level must hold timers.
+    size_t slotsToOccupied(int level, size_t from) const {
+        for (size_t n = 0; n <= wordCount; ++n) {
+            size_t word = (from / 64 + n) % wordCount;
+            std::uint64_t bits = occupied_[level][word];
+            if (n == 0) {
+                bits &= ~std::uint64_t(0) << (from % 64);
+            }
+            if (bits) {
+                return (word * 64 + lowestBit(bits) - from) & (slotCount - 1);
+            }
+        }
+        return 0;
+    }
+
+    static size_t lowestBit(std::uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<size_t>(__builtin_ctzll(bits));
+#else
+        size_t bit = 0;
+        while (!(bits & 1)) {
+            bits >>= 1;
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+
+    template <typename Fire>
+    void step(Fire& fire) {
+        std::uint64_t tick = next_;
+        // Higher levels first, so timers they hand down can land in a slot that
+        // is about to be handed down itself
+        for (int level = levels - 1; level > 0; --level) {
+            if ((tick & ((std::uint64_t(1) << (level * slotBits)) - 1)) == 0) {
+                takeSlot(level, (tick >> (level * slotBits)) & (slotCount - 1));
+                for (Timer& timer : scratch_) {
+                    insert(std::move(timer));
+                }
+                scratch_.clear();
+            }
+        }
+
+        // Swapped out first: timers scheduled by fire() go to later ticks
+        takeSlot(0, tick & (slotCount - 1));
+        next_ = tick + 1;
+        size_ -= scratch_.size();
+        for (Timer& timer : scratch_) {
+            fire(std::move(timer.value));
+        }
+        scratch_.clear();
+    }
+
+    std::vector<Timer> slots_[levels][slotCount];
+    std::vector<Timer> scratch_; // The slot being handed down or fired
+    std::uint64_t next_;         // The first tick not processed yet
+    std::uint64_t occupied_[levels][wordCount] = {}; // Bit per slot that holds timers
+    size_t levelSize_[levels] = {};
+    size_t size_ = 0;
+    std::uint64_t due_ = 0;  // nextOccupiedTick(), while dueKnown_
+    bool dueKnown_ = false;  // Cleared whenever a slot fills or empties
+};
+
+enum class EventPriority {
+    HIGH,
+    NORMAL,
+    LOW
+};
+
+// RingBufferEventQueue with priority lanes and delivery on a later tick.
+// processEvents() drains HIGH before NORMAL before LOW, so when a budget runs
+// out the low priority events are the ones that wait for the next frame.
+// Scheduled events enter their lane on the tick they are due, when the game
+// loop calls advanceTo(). Like RingBufferEventQueue it is for one thread.
+class ScheduledEventQueue {
+public:
+    static const size_t laneCount = 3;
+
+    // Lanes grow when full, so a tick on which many timers expire drops nothing
+    explicit ScheduledEventQueue(size_t laneCapacity, std::uint64_t now = 0) : timers_(now) {
+        for (size_t lane = 0; lane < laneCount; ++lane) {
+            lanes_.emplace_back(new RingBufferEventQueue(laneCapacity, OverflowPolicy::GROW));
+        }
+    }
+
+    void addListener(EventListener* listener) {
+        for (auto& lane : lanes_) {
+            lane->addListener(listener);
+        }
+    }
+
+    // Delivers `event` in the next processEvents() call
+    void enqueue(std::shared_ptr<Event> event, EventPriority priority = EventPriority::NORMAL) {
+        lanes_[static_cast<size_t>(priority)]->enqueue(std::move(event));
+    }
+
+    // Delivers `event` in the first processEvents() call after advanceTo(tick)
+    void schedule(std::shared_ptr<Event> event, std::uint64_t tick, EventPriority priority = EventPriority::NORMAL) {
+        timers_.schedule(Timer{std::move(event), priority}, tick);
+    }
+
+    void scheduleIn(std::shared_ptr<Event> event, std::uint64_t ticks, EventPriority priority = EventPriority::NORMAL) {
+        schedule(std::move(event), now() + ticks, priority);
+    }
+
+    // Moves the events due by `tick` into their lanes
+    void advanceTo(std::uint64_t tick) {
+        timers_.advanceTo(tick, [this](Timer&& timer) {
+            lanes_[static_cast<size_t>(timer.priority)]->enqueue(std::move(timer.event));
+        });
+    }
+
+    void processEvents() {
+        processEvents(EventBudget());
+    }
+
+    // Returns the number of events dispatched
+    size_t processEvents(const EventBudget& budget) {
+        const auto start = std::chrono::steady_clock::now();
+        size_t processed = 0;
+        for (auto& lane : lanes_) {
+            std::chrono::nanoseconds timeLeft = budget.maxTime;
+            if (timeLeft != std::chrono::nanoseconds::max()) {
+                timeLeft -= std::chrono::steady_clock::now() - start;
+                if (timeLeft <= std::chrono::nanoseconds::zero()) {
+                    break;
+                }
+            }
+            processed += lane->processEvents(EventBudget(budget.maxEvents - processed, timeLeft));
+            if (processed == budget.maxEvents || lane->size() > 0) {
+                break; // Out of budget: lower lanes wait
+            }
+        }
+        return processed;
+    }
+
+    std::uint64_t now() const { return timers_.now(); }
+
+    // Events waiting in the lanes
+    size_t size() const {
+        size_t total = 0;
+        for (const auto& lane : lanes_) total += lane->size();
+        return total;
+    }
+
+    // Events scheduled for a later tick
+    size_t pending() const { return timers_.size(); }
+
+private:
+    struct Timer {
+        std::shared_ptr<Event> event;
+        EventPriority priority;
+    };
+
+    std::vector<std::unique_ptr<RingBufferEventQueue>> lanes_; // Indexed by EventPriority
+    TimingWheel<Timer> timers_;
+};
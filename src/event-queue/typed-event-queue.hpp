@@ -0,0 +1,129 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+#include "event-queue.hpp"
+#include "concurrent-event-queue.hpp"
+
+// Dense IDs for event classes, assigned the first time each class is seen.
+// They are only meaningful within one run of the program. IDs may be
+// assigned from several threads at once.
+class EventTypes {
+public:
+    template <typename E>
+    static size_t id() {
+        static const size_t value = of(typeid(E));
+        return value;
+    }
+
+    // The ID of the class with this type_info, e.g. typeid(*event) for the
+    // dynamic type of an event
+    static size_t of(const std::type_info& type) {
+        std::lock_guard<std::mutex> lock(mutex());
+        auto& ids = table();
+        return ids.emplace(std::type_index(type), ids.size()).first->second;
+    }
+
+private:
+    static std::mutex& mutex() {
+        static std::mutex instance;
+        return instance;
+    }
+
+    static std::unordered_map<std::type_index, size_t>& table() {
+        static std::unordered_map<std::type_index, size_t> instance;
+        return instance;
+    }
+};
+
+// RingBufferEventQueue with per-type subscriber lists instead of broadcasting.
+// enqueue() records the event's type ID next to it, so dispatch is a table
+// lookup followed by direct calls to the subscribers of that type. Events of
+// a type nobody subscribed to are released without being looked at.
+//
+// Events are keyed by their dynamic type, so a MessageEvent enqueued through
+// a shared_ptr<Event> still reaches Subscriber<MessageEvent>. Types match
+// exactly: a Subscriber<MessageEvent> does not see events of classes derived
+// from MessageEvent. Like RingBufferEventQueue it is for one thread.
+class TypedEventQueue {
+public:
+    explicit TypedEventQueue(size_t capacity)
+        : mask_(roundUpToPowerOfTwo(capacity < 2 ? 2 : capacity) - 1), buffer_(mask_ + 1) {}
+
+    // Drops the event and counts it in dropped() if the ring is full
+    template <typename E>
+    void enqueue(std::shared_ptr<E> event) {
+        static_assert(std::is_base_of<Event, E>::value, "Only Events can be enqueued");
+        if (head_ - tail_ == mask_ + 1) {
+            ++dropped_;
+            return;
+        }
+        // The static type is almost always the dynamic one, which saves the
+        // locked lookup
+        const std::type_info& type = typeid(*event);
+        Slot& slot = buffer_[head_ & mask_];
+        slot.type = type == typeid(E) ? EventTypes::id<E>() : EventTypes::of(type);
+        slot.event = std::move(event);
+        ++head_;
+    }
+
+    template <typename E>
+    void subscribe(Subscriber<E>* subscriber) {
+        size_t type = EventTypes::id<E>();
+        if (type >= subscribers_.size()) {
+            subscribers_.resize(type + 1);
+        }
+        subscribers_[type].push_back({subscriber, &deliver<E>});
+    }
+
+    void processEvents() {
+        while (tail_ != head_) {
+            Slot& slot = buffer_[tail_ & mask_];
+            if (slot.type < subscribers_.size() && !subscribers_[slot.type].empty()) {
+                for (const Entry& entry : subscribers_[slot.type]) {
+                    entry.deliver(entry.subscriber, *slot.event);
+                }
+            } else {
+                ++unhandled_;
+            }
+            slot.event.reset();
+            ++tail_;
+        }
+    }
+
+    // Events that had no subscribers when they were processed
+    size_t unhandled() const { return unhandled_; }
+
+    // Events discarded because the ring was full
+    size_t dropped() const { return dropped_; }
+
+private:
+    struct Slot {
+        size_t type;
+        std::shared_ptr<Event> event;
+    };
+
+    struct Entry {
+        void* subscriber; // A Subscriber<E>*, for the E this entry was created for
+        void (*deliver)(void* subscriber, const Event& event);
+    };
+
+    // The type ID already proved the event is an E, so a static_cast is enough
+    template <typename E>
+    static void deliver(void* subscriber, const Event& event) {
+        static_cast<Subscriber<E>*>(subscriber)->onEvent(static_cast<const E&>(event));
+    }
+
+    size_t mask_;
+    std::vector<Slot> buffer_;
+    size_t head_ = 0; // Only ever increases; the slot is head_ & mask_
+    size_t tail_ = 0;
+    std::vector<std::vector<Entry>> subscribers_; // Indexed by EventTypes::id()
+    size_t unhandled_ = 0;
+    size_t dropped_ = 0;
+};
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "update-method.hpp"
+#include "batch-world.hpp"
+
+// Benchmark for World's per-entity virtual update() against BatchWorld. Pass
+// the number of entity updates per measurement as the first argument and the
+// largest population to measure as the second to override the defaults. The
+// 32M population, far past the caches, needs over 2 GB and only runs when
+// asked for with a second argument of 32000000 or more.
+
+namespace
+{
+
+template <typename Fn>
+double secondsFor(Fn &&fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+// Bytes the batch kernel reads and writes per entity: its phase
+const double batchBytes = 2 * sizeof(std::uint32_t);
+
+// World::gameLoop() without the console output and the frame delay: a
+// virtual update() per entity, through a vector of pointers to heap objects
+double benchObjects(size_t entities, long frames, std::vector<float> &positions)
+{
+    std::vector<std::unique_ptr<Skeleton>> skeletons;
+    std::vector<Entity *> world;
+    for (size_t i = 0; i < entities; ++i)
+    {
+        skeletons.emplace_back(new Skeleton);
+        skeletons.back()->setX(static_cast<double>(i % 100)); // Directions diverge, as in a real level
+        world.push_back(skeletons.back().get());
+    }
+    double seconds = secondsFor([&] {
+        for (long frame = 0; frame < frames; ++frame)
+        {
+            for (Entity *entity : world)
+            {
+                entity->update();
+            }
+        }
+    });
+    positions.clear();
+    for (Entity *entity : world)
+    {
+        positions.push_back(static_cast<float>(entity->x()));
+    }
+    return seconds;
+}
+
+double benchBatch(size_t entities, long frames, std::vector<float> &positions)
+{
+    PatrolPopulation skeletons;
+    skeletons.reserve(entities);
+    for (size_t i = 0; i < entities; ++i)
+    {
+        skeletons.add(static_cast<float>(i % 100));
+    }
+    BatchWorld world;
+    world.addPopulation(&skeletons);
+    double seconds = secondsFor([&] {
+        for (long frame = 0; frame < frames; ++frame)
+        {
+            world.update();
+        }
+    });
+    positions.clear();
+    for (size_t i = 0; i < skeletons.size(); ++i)
+    {
+        positions.push_back(skeletons.x(i));
+    }
+    return seconds;
+}
+
+// The simplest loop touching the same bytes as the batch kernel: what memory
+// (or cache) bandwidth allows
+double benchStream(size_t entities, long frames)
+{
+    std::vector<float> x(entities, 0.0f);
+    double seconds = secondsFor([&] {
+        for (long frame = 0; frame < frames; ++frame)
+        {
+            float *xs = x.data();
+            for (size_t i = 0; i < entities; ++i)
+            {
+                xs[i] += 1.0f;
+            }
+        }
+    });
+    if (x[entities / 2] != static_cast<float>(frames)) // Keeps the loop from being optimized away
+    {
+        std::cout << "unexpected stream result" << std::endl;
+    }
+    return seconds;
+}
+
+void benchPatrol(long updates, size_t maxEntities)
+{
+    std::cout << "== World (virtual Skeleton::update) vs BatchWorld (PatrolPopulation kernel) ==" << std::endl;
+    for (size_t entities : {size_t(1000), size_t(100000), size_t(1000000), size_t(32000000)})
+    {
+        if (entities > maxEntities)
+        {
+            break;
+        }
+        long frames = std::max(1L, updates / static_cast<long>(entities));
+        double updatesDone = static_cast<double>(entities) * frames;
+
+        std::vector<float> objectPositions, batchPositions;
+        double objects = benchObjects(entities, frames, objectPositions);
+        double batch = benchBatch(entities, frames, batchPositions);
+        double stream = benchStream(entities, frames);
+
+        std::cout << entities << " skeletons x " << frames << " frames: "
+                  << "World " << objects / updatesDone * 1e9 << " ns/entity, "
+                  << "BatchWorld " << batch / updatesDone * 1e9 << " ns/entity ("
+                  << batchBytes * updatesDone / batch / 1e9 << " GB/s), "
+                  << "plain stream " << batchBytes * updatesDone / stream / 1e9 << " GB/s, "
+                  << "speedup x" << objects / batch
+                  << (objectPositions == batchPositions ? "" : " [RESULTS DIFFER]") << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    long updates = argc > 1 ? std::atol(argv[1]) : 50000000;
+    size_t maxEntities = argc > 2 ? static_cast<size_t>(std::atoll(argv[2])) : 1000000;
+
+    benchPatrol(updates, maxEntities);
+
+    return 0;
+}